@@ -17,6 +17,17 @@ UI_DIR = $$DESTDIR/ui
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
+# PropertyReaderT memory-maps files using boost::iostreams::mapped_file,
+# PropertyCursorT and the parallel read_property() use boost::thread,
+# PropertyWriterT::open_append() uses boost::filesystem
+LIBS += -lboost_iostreams-mt -lboost_thread-mt -lboost_filesystem-mt -lboost_system-mt
+
+# optional zlib codec for block-compressed property files, enable with qmake CONFIG+=zlib
+zlib {
+    DEFINES += IMDB_ZLIB
+    LIBS += -lz
+}
+
 macx: CONFIG -= app_bundle
 macx: QMAKE_CXXFLAGS += -Wno-missing-field-initializers
 
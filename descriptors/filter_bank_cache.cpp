@@ -0,0 +1,191 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "filter_bank_cache.hpp"
+#include "../io/property_reader.hpp"
+#include "../io/property_writer.hpp"
+#include "../util/hash.hpp"
+
+namespace imdb {
+
+namespace {
+
+typedef PropertyReaderT<vec_f32_t> reader_t;
+
+// true if p points to memory that can be accessed as floats
+bool float_aligned(const float* p)
+{
+    return reinterpret_cast<std::size_t>(p) % sizeof(float) == 0;
+}
+
+struct cache_t
+{
+    boost::mutex                                    mutex;
+    std::string                                     directory;
+    std::map<std::string, FilterBankCache::bank_t>  banks;
+
+    // keeps the mappings of the banks loaded from files alive
+    std::vector<shared_ptr<reader_t> >              readers;
+};
+
+cache_t& cache()
+{
+    static cache_t c;
+    return c;
+}
+
+// A bank is stored as a property file of vec_f32_t: the first element describes the bank (number of
+// matrices, then rows, cols and channels of each matrix), followed by one element per matrix. The
+// matrices of a loaded bank point directly into the mapped file, files whose elements are not aligned
+// for floats are rejected (store_bank() never writes such files).
+bool load_bank(const std::string& filename, shared_ptr<reader_t>& reader, FilterBankCache::bank_t& bank)
+{
+    reader.reset(new reader_t(filename, PropertyAccessMapped));
+    if (reader->size() == 0) return false;
+
+    boost::iterator_range<const float*> header = reader->view(0);
+    if (header.empty() || !float_aligned(header.begin())) return false;
+
+    std::size_t n = static_cast<std::size_t>(header[0]);
+    if (header.size() != 1 + 3*n || reader->size() != static_cast<index_t>(n + 1)) return false;
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        int rows     = static_cast<int>(header[1 + 3*i]);
+        int cols     = static_cast<int>(header[2 + 3*i]);
+        int channels = static_cast<int>(header[3 + 3*i]);
+
+        boost::iterator_range<const float*> data = reader->view(i + 1);
+        if (data.size() != static_cast<std::size_t>(rows) * cols * channels || !float_aligned(data.begin())) return false;
+
+        bank.push_back(cv::Mat(rows, cols, CV_32FC(channels), const_cast<float*>(data.begin())));
+    }
+    return true;
+}
+
+void store_bank(const std::string& filename, const FilterBankCache::bank_t& bank)
+{
+    namespace fs = boost::filesystem;
+
+    // write to a temporary file first, such that a process starting at the same time never maps a partial file
+    std::string tmp = filename + "." + fs::unique_path().string() + ".tmp";
+    {
+        PropertyWriterT<vec_f32_t> writer(tmp);
+
+        vec_f32_t header(1, static_cast<float>(bank.size()));
+        for (std::size_t i = 0; i < bank.size(); i++)
+        {
+            header.push_back(bank[i].rows);
+            header.push_back(bank[i].cols);
+            header.push_back(bank[i].channels());
+        }
+        writer.push_back(header);
+
+        for (std::size_t i = 0; i < bank.size(); i++)
+        {
+            const float* data = bank[i].ptr<float>();
+            writer.push_back(vec_f32_t(data, data + bank[i].total() * bank[i].channels()));
+        }
+        writer.close();
+    }
+    fs::rename(tmp, filename);
+}
+
+} // anonymous namespace
+
+
+void FilterBankCache::set_directory(const std::string& directory)
+{
+    boost::lock_guard<boost::mutex> locked(cache().mutex);
+    cache().directory = directory;
+}
+
+std::string FilterBankCache::directory()
+{
+    boost::lock_guard<boost::mutex> locked(cache().mutex);
+    return cache().directory;
+}
+
+FilterBankCache::bank_t FilterBankCache::get(const ptree& key, const build_fn& build)
+{
+    namespace fs = boost::filesystem;
+
+    std::ostringstream k;
+    boost::property_tree::write_json(k, key, false);
+
+    cache_t& c = cache();
+
+    // the lock is held while building, such that generators constructed concurrently build each bank once
+    boost::lock_guard<boost::mutex> locked(c.mutex);
+
+    std::map<std::string, bank_t>::const_iterator it = c.banks.find(k.str());
+    if (it != c.banks.end()) return it->second;
+
+    std::string filename;
+    if (!c.directory.empty())
+    {
+        std::ostringstream name;
+        name << key.get<std::string>("filter", "filters") << "_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(k.str().data(), k.str().size());
+        filename = (fs::path(c.directory) / name.str()).string();
+    }
+
+    bank_t bank;
+    if (!filename.empty() && fs::exists(filename))
+    {
+        shared_ptr<reader_t> reader;
+        bool okay = false;
+        try { okay = load_bank(filename, reader, bank); }
+        catch (const std::exception&) {}
+
+        if (okay) c.readers.push_back(reader);
+        else
+        {
+            std::cerr << "FilterBankCache: ignoring invalid file " << filename << std::endl;
+            bank.clear();
+        }
+    }
+
+    if (bank.empty())
+    {
+        build(bank);
+        for (std::size_t i = 0; i < bank.size(); i++)
+        {
+            if (bank[i].depth() != CV_32F) throw std::runtime_error("FilterBankCache: filters must have depth CV_32F");
+            if (!bank[i].isContinuous()) bank[i] = bank[i].clone();
+        }
+
+        // the bank is still usable if it cannot be stored
+        if (!filename.empty())
+        {
+            try
+            {
+                fs::create_directories(c.directory);
+                store_bank(filename, bank);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "FilterBankCache: cannot store " << filename << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    c.banks[k.str()] = bank;
+    return bank;
+}
+
+} // namespace imdb
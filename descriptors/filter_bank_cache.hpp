@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef FILTER_BANK_CACHE_HPP
+#define FILTER_BANK_CACHE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "../util/types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup generators
+ * @brief Process-wide cache of the filter banks of the Gabor based generators (galif, gist).
+ *
+ * Building a filter bank evaluates the filter functions for every frequency of every filter and
+ * easily takes longer than computing the descriptor of an image, which matters for tools that
+ * compute only a few descriptors, e.g. image_search. A filter bank is identified by a key that
+ * contains all parameters that determine the filters. Generator instances with the same key
+ * share one bank. If a directory has been set, banks are also stored there as property files and
+ * memory-mapped by later processes instead of being built again.
+ *
+ * The matrices of a bank must have depth CV_32F. They are shared and, when mapped from a file,
+ * read-only, i.e. they must never be modified.
+ */
+class FilterBankCache
+{
+    public:
+
+    typedef std::vector<cv::Mat>                bank_t;
+    typedef boost::function<void (bank_t&)>     build_fn;
+
+    /// Directory in which filter banks are stored, empty (the default) only shares them within the process.
+    /// Must be set before the generators are constructed.
+    static void set_directory(const std::string& directory);
+
+    static std::string directory();
+
+    /// Returns the bank identified by key. If it is neither in memory nor in the directory, it is
+    /// built by calling build and stored. Safe to be called from several threads.
+    static bank_t get(const ptree& key, const build_fn& build);
+};
+
+} // namespace imdb
+
+#endif // FILTER_BANK_CACHE_HPP
@@ -8,12 +8,17 @@ the terms of the BSD license (see the LICENSE file).
 
 #include <vector>
 
+#include <boost/bind.hpp>
+
 #include <opencv2/imgproc/imgproc.hpp>
 //#include <opencv2/highgui/highgui.hpp>
 
 #include "../util/types.hpp"
 #include "galif.hpp"
 #include "utilities.hpp"
+#include "tile_aggregator.hpp"
+#include "simd_kernels.hpp"
+#include "filter_bank_cache.hpp"
 
 namespace imdb
 {
@@ -81,11 +86,53 @@ void generate_gabor_filter(cv::Mat_<T>& image, double peakFreq, double theta, do
 }
 
 
+// Builds the spectra of the real and the imaginary parts of the filters' impulse responses,
+// first the real parts of all orientations, then the imaginary parts, see galif_generator.
+void build_gabor_filters(FilterBankCache::bank_t& bank, cv::Size size, uint numOrients, double peakFreq, double sigma_x, double sigma_y)
+{
+    FilterBankCache::bank_t re_ft(numOrients), im_ft(numOrients);
+    for (uint i = 0; i < numOrients; i++)
+    {
+        cv::Mat_<std::complex<double> > filter(size);
+        //        cv::Mat_<std::complex<double> > filter_shifted(size);
+        double theta = i*M_PI/numOrients;
+        //        generate_gabor_filter_unshifted(filter, peakFreq, theta, sigma_x, sigma_y);
+        //        fftshift_even(filter, filter_shifted);
+
+        generate_gabor_filter(filter, peakFreq, theta, sigma_x, sigma_y);
+
+        //        // TODO: check this
+        //        // kill DC -- this removes the average value in the response,
+        //        // which we do not want/need in our response images
+        //        filter_shifted(0, 0) = 0;
+        filter(0, 0) = 0;
+
+        // The filter is real in the frequency domain but not symmetric, so its impulse response
+        // g = g_re + i*g_im is complex. Filtering a real image with g amounts to two filterings
+        // with the real images g_re and g_im, these only need real-input transforms, which
+        // work on half the spectrum. We store their spectra in single precision.
+        cv::Mat_<std::complex<double> > impulse;
+        cv::dft(filter, impulse, cv::DFT_INVERSE | cv::DFT_SCALE);
+
+        cv::Mat parts[2];
+        cv::split(impulse, parts);
+
+        cv::Mat re, im;
+        parts[0].convertTo(re, CV_32F);
+        parts[1].convertTo(im, CV_32F);
+        cv::dft(re, re_ft[i]);
+        cv::dft(im, im_ft[i]);
+    }
+    bank.insert(bank.end(), re_ft.begin(), re_ft.end());
+    bank.insert(bank.end(), im_ft.begin(), im_ft.end());
+}
+
+
 galif_generator::galif_generator(const ptree& params)
     : Generator(params,
                 PropertyWriters()
-                .add<vec_vec_f32_t>("features")
-                .add<vec_vec_f32_t>("positions")
+                .add_local_features("features", params.get<string>("generator.feature_precision", "f32"))
+                .add<RaggedMatrix>("positions")
                 .add<int32_t>("numfeatures") // number of visual words/image
                 )
 
@@ -102,6 +149,10 @@ galif_generator::galif_generator(const ptree& params)
     , _smoothHist         (parse<bool>  (_parameters, "generator.smooth_hist", true))
     , _normalizeHist      (parse<string>(_parameters, "generator.normalize_hist", "l2"))    // can be "lowe", "l2", or "none"
     , _samplerName        (parse<string>(_parameters, "generator.sampler.name", "grid"))
+    , _tileAggregation    (parse<string>(_parameters, "generator.tile_aggregation", "filter")) // can be "filter" or "integral", see TileAggregator
+    , _tileBoxes          (TileAggregator::checkNumBoxes(parse<uint>(_parameters, "generator.tile_boxes", 4))) // number of boxes approximating the Gaussian with "integral"
+    , _featurePrecision   (parse<string>(_parameters, "generator.feature_precision", "f32")) // "f32", or "f16"/"q8" to store the features in reduced precision
+    , _tileMode           (TileAggregator::parseMode(_tileAggregation))
     , _sampler            (ImageSampler::create(_samplerName))
 {
 
@@ -130,25 +181,25 @@ galif_generator::galif_generator(const ptree& params)
     std::cout << " generator.smooth_hist=" << _smoothHist << std::endl;
     std::cout << " generator.normalize_hist=" << _normalizeHist << std::endl;
     std::cout << " generator.sampler.name=" << _samplerName << std::endl;
-
+    std::cout << " generator.tile_aggregation=" << _tileAggregation << std::endl;
+    std::cout << " generator.tile_boxes=" << _tileBoxes << std::endl;
+    std::cout << " generator.feature_precision=" << _featurePrecision << std::endl;
+
+    // the filter bank only depends on these parameters and is shared between all instances,
+    // and across processes if FilterBankCache has a directory
+    ptree key;
+    key.put("filter", "galif");
+    key.put("size", paddedSize);
+    key.put("num_orients", _numOrients);
+    key.put("peak_frequency", _peakFrequency);
+    key.put("sigma_x", sigma_x);
+    key.put("sigma_y", sigma_y);
+
+    FilterBankCache::bank_t bank = FilterBankCache::get(key, boost::bind(build_gabor_filters, _1, _filterSize, _numOrients, _peakFrequency, sigma_x, sigma_y));
     for (uint i = 0; i < _numOrients; i++)
     {
-        cv::Mat_<std::complex<double> > filter(_filterSize);
-        //        cv::Mat_<std::complex<double> > filter_shifted(_filterSize);
-        double theta = i*M_PI/_numOrients;
-        //        generate_gabor_filter_unshifted(filter, _peakFrequency, theta, sigma_x, sigma_y);
-        //        fftshift_even(filter, filter_shifted);
-
-        generate_gabor_filter(filter, _peakFrequency, theta, sigma_x, sigma_y);
-
-        //        // TODO: check this
-        //        // kill DC -- this removes the average value in the response,
-        //        // which we do not want/need in our response images
-        //        filter_shifted(0, 0) = 0;
-        filter(0, 0) = 0;
-
-        //        _gaborFilter.push_back(filter_shifted);
-        _gaborFilter.push_back(filter);
+        _gaborFilterRe.push_back(bank[i]);
+        _gaborFilterIm.push_back(bank[_numOrients + i]);
     }
 
 
@@ -172,13 +223,53 @@ galif_generator::galif_generator(const ptree& params)
 }
 
 
+ImageRequirements galif_generator::input_requirements() const
+{
+    // the image is scaled such that its longer side is _width
+    return ImageRequirements(_width, 0, true);
+}
+
+// the images of extract() and the keypoints, these keep their memory from one image to the next
+struct galif_generator::GalifWorkspace : public Generator::Workspace
+{
+    vec_vec_f32_t           keypoints;
+    vector<index_t>         emptyFeatures;
+
+    cv::Mat_<float>         src;
+    cv::Mat_<float>         src_ft;
+    cv::Mat_<float>         dst_ft;
+    cv::Mat_<float>         dst_re;
+    cv::Mat_<float>         dst_im;
+    cv::Mat_<unsigned char> inverted;
+    cv::Mat_<int>           integral;
+
+    // response magnitudes have the size of the filters, such that images of any size fit,
+    // responses are their parts covering the current image
+    std::vector<cv::Mat>    magnitudes;
+    std::vector<cv::Mat>    responses;
+
+    TileAggregator          tiles;
+};
+
+shared_ptr<Generator::Workspace> galif_generator::create_workspace() const
+{
+    return boost::make_shared<GalifWorkspace>();
+}
+
 void galif_generator::compute(anymap_t& data) const
+{
+    GalifWorkspace workspace;
+    compute(data, workspace);
+}
+
+void galif_generator::compute(anymap_t& data, Workspace& workspace) const
 {
     // --------------------------------------------------------------
     // prerequisites:
     //
     // this generator expects a 3-channel image, with
     // each channel containing exactly the same pixel values
+    // (or a grayscale image_gray, see input_requirements())
     //
     // the image must have a white background with black sketch lines
     // --------------------------------------------------------------
@@ -186,50 +277,45 @@ void galif_generator::compute(anymap_t& data) const
     using namespace std;
     using namespace cv;
 
-    Mat img = get<mat_8uc3_t>(data, "image");
-    Mat imgGray;
+    GalifWorkspace& ws = dynamic_cast<GalifWorkspace&>(workspace);
 
-    cvtColor(img, imgGray, CV_RGB2GRAY);
+    // scale image to desired size, the scaled image is shared with other
+    // generators working on the same data that need the same size
+    Mat scaled = scaledGrayscaleImage(data, CV_RGB2GRAY, _width);
 
-    assert(imgGray.type() == CV_8UC1);
-
-    // scale image to desired size
-    Mat scaled;
-    scale(imgGray, scaled);
+    assert(scaled.type() == CV_8UC1);
 
     // detect keypoints on the scaled image
     // the keypoint cooredinates lie in the domain defined by
     // the scaled image size, i.e. if the image has been scaled
     // to 256x256, keypoint coordinates lie in [0,255]x[0,255]
-    vec_vec_f32_t keypoints;
-    detect(scaled, keypoints);
-
-    // extract local features at the given keypoints
-    vec_vec_f32_t features;
-    vector<index_t> emptyFeatures;
-    extract(scaled, keypoints, features, emptyFeatures);
-    assert(features.size() == keypoints.size());
-    assert(emptyFeatures.size() == keypoints.size());
-    (features.size() == keypoints.size());
-
-
-    // normalize keypoints to range [0,1]x[0,1] so they are
-    // independent of image size
-    vec_vec_f32_t keypointsNormalized;
-    normalizePositions(keypoints, scaled.size(), keypointsNormalized);
-
-
-    // remove features that are empty, i.e. that contain
-    // no sketch stroke within their area
-    vec_vec_f32_t featuresFiltered;
-    vec_vec_f32_t keypointsNormalizedFiltered;
-    filterEmptyFeatures(features, keypointsNormalized, emptyFeatures, featuresFiltered, keypointsNormalizedFiltered);
-    assert(featuresFiltered.size() == keypointsNormalizedFiltered.size());
-
-    // store
-    data["features"] = featuresFiltered;
-    data["positions"] = keypointsNormalizedFiltered;
-    data["numfeatures"] = static_cast<int32_t>(featuresFiltered.size());
+    const vec_vec_f32_t& keypoints = ws.keypoints;
+    detect(scaled, ws.keypoints);
+
+    // extract local features at the given keypoints. Features that
+    // contain no sketch stroke within their area are left out, the
+    // others are written directly into the result
+    RaggedMatrix features;
+    extract(scaled, keypoints, ws, features, ws.emptyFeatures, false);
+
+    // normalize the positions of the remaining features to
+    // range [0,1]x[0,1] so they are independent of image size
+    RaggedMatrix positions;
+    positions.reserve(features.size(), 2*features.size());
+    for (size_t i = 0; i < keypoints.size(); i++)
+    {
+        if (ws.emptyFeatures[i]) continue;
+
+        RaggedMatrix::row p = positions.append(2);
+        p[0] = keypoints[i][0] / scaled.cols;
+        p[1] = keypoints[i][1] / scaled.rows;
+    }
+    assert(features.size() == positions.size());
+
+    // store, features and positions are moved into data
+    data["numfeatures"] = static_cast<int32_t>(features.size());
+    put(data, "features", features);
+    put(data, "positions", positions);
 }
 
 
@@ -264,7 +350,13 @@ void galif_generator::assertImageSize(const cv::Mat& image) const
     assert((image.size().width <= _filterSize.height) && (image.size().height <= _filterSize.width));
 }
 
-void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, vec_vec_f32_t& features, vector<index_t> &emptyFeatures) const
+void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, RaggedMatrix& features, vector<index_t> &emptyFeatures) const
+{
+    GalifWorkspace workspace;
+    extract(image, keypoints, workspace, features, emptyFeatures, true);
+}
+
+void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, GalifWorkspace& ws, RaggedMatrix& features, vector<index_t>& emptyFeatures, bool keepEmpty) const
 {
     assert(image.type() == CV_8UC1);
     assertImageSize(image);
@@ -272,57 +364,58 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
     // copy input image centered onto a white background image with
     // exactly the size of our gabor filters
     // WARNING: white background assumed!!!
-    cv::Mat_<std::complex<double> > src(_filterSize, 1.0);
-    cv::Mat_<unsigned char> inverted = cv::Mat_<unsigned char>::zeros(_filterSize);
+    // All images of the workspace always have the filter size, create() only allocates them for the first image
+    cv::Mat_<float>& src = ws.src;
+    src.create(_filterSize);
+    src.setTo(cv::Scalar(1.0));
+
+    cv::Mat_<unsigned char>& inverted = ws.inverted;
+    inverted.create(_filterSize);
+    inverted.setTo(cv::Scalar(0));
+
     for (int r = 0; r < image.rows; r++)
-        for (int c = 0; c < image.cols; c++)
-        {
-            // this should set the real part to the desired value
-            // in the range [0,1] and the complex part to 0
-            src(r, c) = static_cast<double>(image.at<unsigned char>(r, c)) * (1.0/255.0);
-            inverted(r, c) = 255 - image.at<unsigned char>(r, c);
-        }
+    {
+        // the desired value in the range [0,1]
+        const unsigned char* row = image.ptr<unsigned char>(r);
+        u8ToFloat(row, src[r], image.cols, 1.0f/255.0f);
+        invertU8(row, inverted[r], image.cols);
+    }
 
-    cv::Mat_<int> integral;
+    cv::Mat_<int>& integral = ws.integral;
     cv::integral(inverted, integral, CV_32S);
 
-    // just a sanity check that the complex part
-    // is correctly default initialized to 0
-    assert(src(0,0).imag() == 0);
-
     // filter scaled input image by directional filter bank
-    // transform source to frequency domain
-    cv::Mat_<std::complex<double> > src_ft(_filterSize);
+    // transform source to frequency domain, for real input cv::dft only
+    // computes half of the (conjugate symmetric) spectrum, packed in the CCS layout
+    cv::Mat_<float>& src_ft = ws.src_ft;
     cv::dft(src, src_ft);
 
     // apply each filter
-    std::vector<cv::Mat> responses;
+    std::vector<cv::Mat>& responses = ws.responses;
+    cv::Mat_<float>& dst_ft = ws.dst_ft;
+    cv::Mat_<float>& dst_re = ws.dst_re;
+    cv::Mat_<float>& dst_im = ws.dst_im;
+    cv::Rect image_rect(0, 0, image.cols, image.rows);
+    ws.magnitudes.resize(_numOrients);
+    responses.resize(_numOrients);
     for (uint i = 0; i < _numOrients; i++)
     {
-        // convolve in frequency domain (i.e. multiply spectrums)
-        cv::Mat_<std::complex<double> > dst_ft(_filterSize);
-
-        // it remains unclear what the 4th parameter stands for
-        // OpenCV 2.1 doc: "The same flags as passed to dft() ; only the flag DFT_ROWS is checked for"
-        cv::mulSpectrums(src_ft, _gaborFilter[i], dst_ft, 0);
-
-        // transform back to spatial domain
-        cv::Mat_<std::complex<double> > dst;
-        cv::dft(dst_ft, dst, cv::DFT_INVERSE | cv::DFT_SCALE);
-
-        // compute magnitude of response
-        cv::Mat mag(image.size(), CV_32FC1);
-        for (int r = 0; r < mag.rows; r++)
-            for (int c = 0; c < mag.cols; c++)
-            {
-                const std::complex<double>& v = dst(r, c);
-                float m = std::sqrt(v.real() * v.real() + v.imag() * v.imag());
-                mag.at<float>(r, c) = m;
-            }
-
-        //cv::imwrite("mag.png", mag*255);
-
-        responses.push_back(mag);
+        // convolve in frequency domain (i.e. multiply spectrums) with the real and the imaginary
+        // part of the filter, both results are real and give the real and imaginary part of the
+        // response, see the constructor. mulSpectrums() handles the CCS layout.
+        cv::mulSpectrums(src_ft, _gaborFilterRe[i], dst_ft, 0);
+        cv::dft(dst_ft, dst_re, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        cv::mulSpectrums(src_ft, _gaborFilterIm[i], dst_ft, 0);
+        cv::dft(dst_ft, dst_im, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        // compute magnitude of response, magnitude() writes into the
+        // part of the buffer covering the image as it has the right size
+        ws.magnitudes[i].create(_filterSize, CV_32FC1);
+        responses[i] = ws.magnitudes[i](image_rect);
+        cv::magnitude(dst_re(image_rect), dst_im(image_rect), responses[i]);
+
+        //cv::imwrite("mag.png", responses[i]*255);
     }
 
     // local region size is relative to image size
@@ -337,49 +430,25 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
     int tileSize = featureSize / _tiles;
     float halfTileSize = (float) tileSize / 2;
 
-    for (size_t i = 0; i < _numOrients; i++)
-    {
-        // copy response image centered into a new, larger image that contains an empty border
-        // of size tileSize around all sides. This additional  border is essential to be able to
-        // later compute values outside of the original image bounds
-        cv::Mat framed = cv::Mat::zeros(image.rows + 2*tileSize, image.cols + 2*tileSize, CV_32FC1);
-        cv::Mat image_rect_in_frame = framed(cv::Rect(tileSize, tileSize, image.cols, image.rows));
-        responses[i].copyTo(image_rect_in_frame);
-
-        if (_smoothHist)
-        {
-            int kernelSize = 2 * tileSize + 1;
-            float gaussBlurSigma = tileSize / 3.0;
-
-            // TODO: border type?
-            cv::GaussianBlur(framed, framed, cv::Size(kernelSize, kernelSize), gaussBlurSigma, gaussBlurSigma);
-        }
-        else
-        {
-            int kernelSize = tileSize;
-
-            // TODO: border type?
-            cv::boxFilter(framed, framed, CV_32F, cv::Size(kernelSize, kernelSize), cv::Point(-1, -1), false);
-        }
-
-        // response have now size of image + 2*tileSize in each dimension
-        responses[i] = framed;
-    }
+    // smoothed responses, these are sampled at the tile centers of each feature below
+    TileAggregator& tiles = ws.tiles;
+    tiles.reset(responses, tileSize, _smoothHist, _tileMode, _tileBoxes);
 
     // will contain a 1 at each index where the underlying patch in the
     // sketch is completely empty, i.e. contains no stroke, 0 at all other
     // indices. Therefore it is essentail that this vector has the same size
     // as the keypoints and features vector
-    emptyFeatures.resize(keypoints.size(), 0);
+    emptyFeatures.assign(keypoints.size(), 0);
+
+    // all histograms are stored in a single buffer, reserve it upfront
+    const size_t histogramSize = _tiles * _tiles * _numOrients;
+    features.reserve(features.size() + keypoints.size(), features.num_values() + keypoints.size() * histogramSize);
 
     // collect filter responses for each keypoint/region
     for (size_t i = 0; i < keypoints.size(); i++)
     {
         const vec_f32_t& keypoint = keypoints[i];
 
-        // create histogram: row <-> tile, column <-> histogram of directional responses
-        vec_f32_t histogram(_tiles * _tiles * _numOrients, 0.0f);
-
         // define region
         cv::Rect rect(keypoint[0] - featureSize/2, keypoint[1] - featureSize/2, featureSize, featureSize);
 
@@ -398,15 +467,17 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
         if (patchsum == 0)
         {
             // skip this patch. It contains no strokes.
-            // add empty histogram, filled with zeros,
+            // keep the empty histogram (if requested), filled with zeros,
             // will be (optionally) filtered in a later descriptor computation step
-            features.push_back(histogram);
             emptyFeatures[i] = 1;
+            if (keepEmpty) features.append(histogramSize);
             continue;
         }
 
-        const int ndims[3] = { _tiles, _tiles, _numOrients };
-        cv::Mat_<float> hist(3, ndims, 0.0f);
+        // create histogram: tile (ty, tx) <-> histogram of directional responses at index
+        // (ty * _tiles + tx) * _numOrients. The histogram is a zero-filled row in features
+        // that is filled in place
+        RaggedMatrix::row histogram = features.append(histogramSize);
 
         for (size_t k = 0; k < responses.size(); k++)
         {
@@ -415,7 +486,7 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
                 {
                     // check for out of bounds condition
                     // NOTE: we have added a frame with the size of a tile
-                    if (y < 0 || x < 0 || y >= responses[k].rows || x >= responses[k].cols)
+                    if (y < 0 || x < 0 || y >= image.rows + 2*tileSize || x >= image.cols + 2*tileSize)
                     {
                         continue;
                     }
@@ -431,12 +502,10 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
                     assert(tx >= 0 && ty >= 0);
                     assert(static_cast<uint>(tx) < _tiles && static_cast<uint>(ty)  < _tiles);
 
-                    hist(ty, tx, k) = responses[k].at<float>(y, x);
+                    histogram[(ty * _tiles + tx) * _numOrients + k] = tiles.sample(k, x - tileSize, y - tileSize);
                 }
         }
 
-        std::copy(hist.begin(), hist.end(), histogram.begin());
-
         if (_normalizeHist == "l2")
         {
             float sum = 0;
@@ -446,12 +515,12 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
         }
         else if (_normalizeHist == "lowe")
         {
-            cv::Mat histwrap(histogram);
+            // wraps the histogram's data, normalization is done in place
+            cv::Mat histwrap(histogram.size(), 1, CV_32FC1, histogram.begin());
             cv::Mat tmp;
             cv::normalize(histwrap, tmp, 1, 0, cv::NORM_L1);
             tmp = cv::min(tmp, 0.2);
             cv::normalize(histwrap, histwrap, 1, 0, cv::NORM_L1);
-            histogram = histwrap;
         }
 
         // do not normalize if user has explicitly asked for that
@@ -459,9 +528,6 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
 
         // let the user know about the wrong parameter
         else throw std::runtime_error("unsupported histogram normalization method passed (" + _normalizeHist + ")." + "Allowed methods are : lowe, l2, none." );
-
-        // add histogram to the set of local features for that image
-        features.push_back(histogram);
     }
 
 
@@ -14,6 +14,7 @@ the terms of the BSD license (see the LICENSE file).
 #include "../util/types.hpp"
 #include "generator.hpp"
 #include "image_sampler.hpp"
+#include "tile_aggregator.hpp"
 
 namespace imdb
 {
@@ -30,14 +31,27 @@ class galif_generator : public Generator
 
     void compute(anymap_t& data) const;
 
+    /// Reuses the images of extract() and the keypoints, and writes the histograms
+    /// of the non-empty features directly into the result
+    void compute(anymap_t& data, Workspace& workspace) const;
+
+    shared_ptr<Workspace> create_workspace() const;
+
+    ImageRequirements input_requirements() const;
+
     double scale(const cv::Mat& image, cv::Mat& scaled) const;
 
     void detect(const cv::Mat& image, vec_vec_f32_t& keypoints) const;
 
-    void extract(const cv::Mat& image, const vec_vec_f32_t &keypoints, vec_vec_f32_t& features, vector<index_t> &emptyFeatures) const;
+    void extract(const cv::Mat& image, const vec_vec_f32_t &keypoints, RaggedMatrix& features, vector<index_t> &emptyFeatures) const;
 
     private:
 
+    struct GalifWorkspace;
+
+    // extract() using the buffers of ws, empty features are only appended to features if keepEmpty
+    void extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, GalifWorkspace& ws, RaggedMatrix& features, vector<index_t>& emptyFeatures, bool keepEmpty) const;
+
     void assertImageSize(const cv::Mat& image) const;
 
     const uint         _width;
@@ -50,9 +64,18 @@ class galif_generator : public Generator
     const bool         _smoothHist;
     const string       _normalizeHist;
     const string       _samplerName;
+    const string       _tileAggregation;
+    const uint         _tileBoxes;
+    const string       _featurePrecision;
+    const TileAggregator::Mode _tileMode;
 
     cv::Size _filterSize;
-    vector<cv::Mat_<std::complex<double> > > _gaborFilter;
+
+    // spectra of the real and the imaginary part of each filter's impulse response, both
+    // are real images and stored in the packed CCS layout of cv::dft, see extract(). The
+    // spectra are shared through FilterBankCache and must not be modified.
+    vector<cv::Mat_<float> > _gaborFilterRe;
+    vector<cv::Mat_<float> > _gaborFilterIm;
     shared_ptr<ImageSampler> _sampler;
 
 };
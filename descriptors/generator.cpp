@@ -67,6 +67,21 @@ Generator::Generator(const ptree& parameters, const PropertyWriters& propertyWri
 
 Generator::~Generator() {}
 
+void Generator::compute(anymap_t& data, Workspace&) const
+{
+    compute(data);
+}
+
+shared_ptr<Generator::Workspace> Generator::create_workspace() const
+{
+    return boost::make_shared<Workspace>();
+}
+
+ImageRequirements Generator::input_requirements() const
+{
+    return ImageRequirements();
+}
+
 
 // Note can't return as const as a common usecase is
 // to open() the writers for actually writing to a file
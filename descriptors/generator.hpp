@@ -16,6 +16,7 @@ the terms of the BSD license (see the LICENSE file).
 #include "util/types.hpp"
 #include "util/registry.hpp"
 #include "io/property_writer.hpp"
+#include "io/image_loader.hpp"
 
 
 namespace imdb {
@@ -32,6 +33,19 @@ class Generator
 
     typedef map<string, function<shared_ptr<Generator> (const ptree&)> > generators_t;
 
+    /**
+     * @brief Buffers a Generator reuses from one image to the next, see create_workspace().
+     *
+     * Generators that allocate large intermediate images derive their own workspace from this
+     * class. A workspace belongs to the Generator that created it and must only be used by one
+     * thread at a time, typically each computing thread creates one and keeps it.
+     */
+    class Workspace
+    {
+        public:
+        virtual ~Workspace() {}
+    };
+
     // -----------------------------------
     // static functions
     // -----------------------------------
@@ -135,6 +149,35 @@ class Generator
      */
     virtual void compute(anymap_t& data) const = 0;
 
+    /**
+     * @brief Extract features from data, reusing the buffers in workspace.
+     *
+     * Gives the same results as compute(data). Once the buffers have grown to the size needed by the
+     * images at hand, this does not allocate memory apart from the results stored in data. The
+     * default implementation ignores the workspace and calls compute(data).
+     *
+     * @param workspace Must have been created by create_workspace() of this Generator
+     */
+    virtual void compute(anymap_t& data, Workspace& workspace) const;
+
+    /**
+     * @brief Creates the workspace to be passed to compute(data, workspace).
+     *
+     * The default implementation returns an empty Workspace.
+     */
+    virtual shared_ptr<Workspace> create_workspace() const;
+
+
+    /**
+     * @brief Describes the image this Generator needs as input.
+     *
+     * compute_descriptors uses this to decode images at a reduced resolution and/or as grayscale images
+     * where possible. A Generator that declares grayscale input receives the image as "image_gray"
+     * (mat_8uc1_t) instead of "image", but should still accept "image" as other callers (e.g. image_search)
+     * only provide that. The default implementation requests the full resolution color image.
+     */
+    virtual ImageRequirements input_requirements() const;
+
 
     // Note: we cannot return as const as a common usecase is
     // to open() the writers for actually writing to a file
@@ -13,11 +13,16 @@ the terms of the BSD license (see the LICENSE file).
 
 #include <QImage>
 
+#include <boost/bind.hpp>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "gist.hpp"
 #include "gist_helper.hpp"
+#include "utilities.hpp"
+#include "simd_kernels.hpp"
+#include "filter_bank_cache.hpp"
 
 namespace imdb {
 
@@ -26,7 +31,8 @@ gist_generator::gist_generator(const ptree& params)
      PropertyWriters()
 //     .add<vec_f32_t>("features_mean")
 //     .add<vec_f32_t>("features_variance")
-     .add<vec_f32_t>("features")
+     // dense and reduced precision feature files are opt-in, existing readers expect vec_f32_t property files
+     .add_vectors("features", params.get<bool>("generator.dense_features", false), params.get<string>("generator.feature_precision", "f32"))
    )
 
  , _padding       (parse<size_t>     (_parameters, "generator.padding"       , 64             )) // padding (adds to width and height)
@@ -42,6 +48,8 @@ gist_generator::gist_generator(const ptree& params)
  , _angle_factor  (parse<double>     (_parameters, "generator.angle_factor"  , 1.0            )) // circular width factor
  , _polar         (parse<bool>       (_parameters, "generator.polar"         , true           )) // use polar gabor filter construction
  , _prefilter_str (parse<string>     (_parameters, "generator.prefilter"     , "torralba"     )) // use prefilter (none, torralba)
+ , _dense_features(parse<bool>       (_parameters, "generator.dense_features", false          )) // write features as a dense matrix (see DensePropertyWriter)
+ , _feature_precision(parse<string>  (_parameters, "generator.feature_precision", "f32"         )) // f32, or f16/q8 to store the features in reduced precision
 
  , _width(_realwidth + _padding)
  , _height(_realheight + _padding)
@@ -51,19 +59,23 @@ gist_generator::gist_generator(const ptree& params)
     init_filter();
 }
 
+ImageRequirements gist_generator::input_requirements() const
+{
+    // the image is scaled such that it fits into _realwidth x _realheight
+    return ImageRequirements(static_cast<int>(std::max(_realwidth, _realheight)), 0, true);
+}
+
 void gist_generator::compute(anymap_t& data) const
 {
 
     // ------------------------------------------------------------------------
     // Required input:
     //
-    // this generator expects the image to be a CV_8UC3 with BGR channel order.
+    // this generator expects the image to be a CV_8UC3 with BGR channel order
+    // (or a grayscale image_gray, see input_requirements()).
     // ------------------------------------------------------------------------
 
-    cv::Mat imgColor = get<mat_8uc3_t>(data, "image");
-
-    cv::Mat image;
-    cv::cvtColor(imgColor, image, CV_BGR2GRAY);
+    cv::Mat image = grayscaleImage(data, CV_BGR2GRAY);
 
     // uniformly scale the image such that it has no side that is larger than the filter's size
     double scaling_factor = (image.size().width > image.size().height)
@@ -71,9 +83,12 @@ void gist_generator::compute(anymap_t& data) const
                           : static_cast<double>(_realheight) / image.size().height;
 
 
-    // need to use INTER_AREA for downscaling as only this performs correct antialiasing
+    // need to use INTER_AREA for downscaling as only this performs correct antialiasing.
+    // For a square filter this is what scaledGrayscaleImage() does, which shares the
+    // scaled image with other generators working on the same data
     cv::Mat scaled;
-    cv::resize(image, scaled, cv::Size(), scaling_factor, scaling_factor, cv::INTER_AREA);
+    if (_realwidth == _realheight) scaled = scaledGrayscaleImage(data, CV_BGR2GRAY, static_cast<int>(_realwidth));
+    else cv::resize(image, scaled, cv::Size(), scaling_factor, scaling_factor, cv::INTER_AREA);
 
     cv::Mat_<unsigned char> padded(_height, _width);
     symmetric_pad(cv::Mat_<unsigned char>(scaled), padded);
@@ -82,12 +97,12 @@ void gist_generator::compute(anymap_t& data) const
     // for example the torralba prefilter
     if (_prefilter_ocv) _prefilter_ocv(padded);
 
+    // std::complex<float> is stored as an array of two floats, the values are
+    // scaled in double precision
     cv::Mat_<complex_t> src(_height, _width);
-    cv::MatConstIterator_<unsigned char> sit = padded.begin();
-    cv::MatIterator_<complex_t> dit = src.begin();
-    while (sit != padded.end())
+    for (int r = 0; r < padded.rows; r++)
     {
-        *dit++ = (float_t) *sit++ * (1.0/255.0);
+        u8ToComplex(padded[r], reinterpret_cast<float_t*>(src[r]), padded.cols, 1.0/255.0);
     }
 
     // transform image into fourier space
@@ -116,11 +131,8 @@ void gist_generator::compute(anymap_t& data) const
         // compute the response magnitude
         cv::Mat_<float_t> mag(_height, _width);
         for (int r = 0; r < dst.rows; r++)
-        for (int c = 0; c < dst.cols; c++)
         {
-            float_t real = dst(r, c).real();
-            float_t imag = dst(r, c).imag();
-            mag(r, c) = std::sqrt(real*real + imag*imag);
+            complexMagnitude(reinterpret_cast<const float_t*>(dst[r]), mag[r], dst.cols);
         }
 
         // get mean and standard deviation of tile contents
@@ -145,10 +157,31 @@ void gist_generator::compute(anymap_t& data) const
 
 //    data["features_mean"] = means;
 //    data["features_variance"] = vars;
-    data["features"] = means_vars;
+    put(data, "features", means_vars);
 }
 
 void gist_generator::init_filter()
+{
+    // the filter bank only depends on these parameters and is shared between all instances,
+    // and across processes if FilterBankCache has a directory
+    ptree key;
+    key.put("filter", "gist");
+    key.put("width", _width);
+    key.put("height", _height);
+    key.put("padding", _padding);
+    key.put("num_freqs", _num_freqs);
+    key.put("num_orients", _num_orients);
+    key.put("max_peak_freq", _max_peak_freq);
+    key.put("delta_freq_oct", _delta_freq_oct);
+    key.put("bandwidth_oct", _bandwidth_oct);
+    key.put("angle_factor", _angle_factor);
+    key.put("polar", _polar);
+
+    FilterBankCache::bank_t bank = FilterBankCache::get(key, boost::bind(&gist_generator::build_filters, this, _1));
+    _filters.assign(bank.begin(), bank.end());
+}
+
+void gist_generator::build_filters(FilterBankCache::bank_t& bank) const
 {
     const double delta_freq = std::pow(2.0, _delta_freq_oct);
     const double bandwidth = std::pow(2.0, _bandwidth_oct);
@@ -180,7 +213,7 @@ void gist_generator::init_filter()
             filter(0, 0) = 0;
 
             // add
-            _filters.push_back(filter);
+            bank.push_back(filter);
         }
     }
 }
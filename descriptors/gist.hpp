@@ -16,6 +16,7 @@ the terms of the BSD license (see the LICENSE file).
 
 #include "../util/types.hpp"
 #include "../descriptors/generator.hpp"
+#include "../descriptors/filter_bank_cache.hpp"
 
 namespace imdb
 {
@@ -35,10 +36,14 @@ class gist_generator : public Generator
 
     void compute(anymap_t& data) const;
 
+    ImageRequirements input_requirements() const;
+
     private:
 
     void init_filter();
 
+    void build_filters(FilterBankCache::bank_t& bank) const;
+
     const size_t _padding;
 
     const size_t _realwidth;
@@ -59,10 +64,16 @@ class gist_generator : public Generator
 
     const std::string _prefilter_str;
 
+    const bool   _dense_features;
+
+    const std::string _feature_precision;
+
     const size_t _width;
     const size_t _height;
 
     boost::function<void (cv::Mat&)> _prefilter_ocv;
+
+    // shared through FilterBankCache, must not be modified
     std::vector<cv::Mat_<complex_t> > _filters;
 };
 
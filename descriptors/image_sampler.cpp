@@ -31,14 +31,17 @@ void grid_sampler::sample(vec_vec_f32_t& samples, const cv::Mat& image) const
     float stepX = samplingArea.width / static_cast<float>(numSamples1D+1);
     float stepY = samplingArea.height / static_cast<float>(numSamples1D+1);
 
+    samples.resize(numSamples1D*numSamples1D);
+
+    size_t i = 0;
     for (uint x = 1; x <= numSamples1D; x++) {
         uint posX = x*stepX;
         for (uint y = 1; y <= numSamples1D; y++) {
             uint posY = y*stepY;
-            vec_f32_t p(2);
+            vec_f32_t& p = samples[i++];
+            p.resize(2);
             p[0] = posX;
             p[1] = posY;
-            samples.push_back(p);
         }
     }
 }
@@ -52,9 +55,6 @@ void random_area_sampler::setParameters(ptree &params)
 
 void random_area_sampler::sample(vec_vec_f32_t& samples, const cv::Mat& image) const
 {
-    // prevent logical error
-    assert(samples.size() == 0);
-
     cv::Rect samplingArea(0, 0, image.size().width, image.size().height);
 
     int w = samplingArea.width;
@@ -68,12 +68,13 @@ void random_area_sampler::sample(vec_vec_f32_t& samples, const cv::Mat& image) c
     boost::variate_generator<boost::mt19937&, boost::uniform_int<> > x_generator(rng, boost::uniform_int<>(0,w-1));
     boost::variate_generator<boost::mt19937&, boost::uniform_int<> > y_generator(rng, boost::uniform_int<>(0,h-1));
 
-    vec_f32_t p(2);
+    samples.resize(_numSamples);
     for (uint i = 0; i < _numSamples; i++)
     {
+        vec_f32_t& p = samples[i];
+        p.resize(2);
         p[0] = x_generator();
         p[1] = y_generator();
-        samples.push_back(p);
     }
 }
 
@@ -56,6 +56,8 @@ public:
 
     virtual ~ImageSampler() {}
 
+    // replaces the contents of samples by the sample points, the memory of
+    // samples is reused such that sampling into the same vector does not allocate
     virtual void sample(vec_vec_f32_t& samples, const cv::Mat& image) const=0;
 
 private:
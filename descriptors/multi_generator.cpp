@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <set>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "multi_generator.hpp"
+#include "utilities.hpp"
+
+namespace imdb {
+
+MultiGenerator::MultiGenerator(const generators_t& generators)
+    : Generator(combined_parameters(generators), combined_writers(generators))
+    , _generators(generators)
+    , _grayscale(false)
+{
+    for (size_t i = 0; i < _generators.size(); i++)
+    {
+        _grayscale |= _generators[i].second->input_requirements().grayscale;
+    }
+}
+
+ptree MultiGenerator::combined_parameters(const generators_t& generators)
+{
+    if (generators.empty()) throw std::runtime_error("MultiGenerator: no generators given");
+
+    std::set<std::string> prefixes;
+    ptree params;
+    params.put("generator.name", "multi");
+
+    for (size_t i = 0; i < generators.size(); i++)
+    {
+        const std::string& prefix = generators[i].first;
+        if (!prefixes.insert(prefix).second) throw std::runtime_error("MultiGenerator: prefix used twice: " + prefix);
+
+        // prefixes may contain the path separator of ptree, use an explicit path
+        params.add_child(ptree::path_type(prefix, '\0'), generators[i].second->parameters());
+    }
+    return params;
+}
+
+PropertyWriters MultiGenerator::combined_writers(const generators_t& generators)
+{
+    PropertyWriters writers;
+    for (size_t i = 0; i < generators.size(); i++)
+    {
+        PropertyWriters::properties_t& properties = generators[i].second->propertyWriters().get();
+        for (PropertyWriters::properties_t::const_iterator it = properties.begin(); it != properties.end(); ++it)
+        {
+            writers.add(generators[i].first + it->first, it->second);
+        }
+    }
+    return writers;
+}
+
+void MultiGenerator::compute(anymap_t& data) const
+{
+    compute(data, *create_workspace());
+}
+
+shared_ptr<Generator::Workspace> MultiGenerator::create_workspace() const
+{
+    shared_ptr<MultiWorkspace> workspace = boost::make_shared<MultiWorkspace>();
+    for (size_t i = 0; i < _generators.size(); i++)
+    {
+        workspace->workspaces.push_back(_generators[i].second->create_workspace());
+    }
+    return workspace;
+}
+
+void MultiGenerator::compute(anymap_t& data, Workspace& workspace) const
+{
+    MultiWorkspace& ws = dynamic_cast<MultiWorkspace&>(workspace);
+
+    // convert to grayscale once for all generators. This uses the same conversion
+    // as the loader when decoding grayscale images, i.e. each generator sees the
+    // same input as when running on its own in compute_descriptors
+    if (_grayscale && !data.count("image_gray"))
+    {
+        data["image_gray"] = mat_8uc1_t(grayscaleImage(data, CV_BGR2GRAY));
+    }
+
+    for (size_t i = 0; i < _generators.size(); i++)
+    {
+        const std::string& prefix = _generators[i].first;
+        _generators[i].second->compute(data, *ws.workspaces[i]);
+
+        // move the results to their prefixed names, such that the next
+        // generator does not overwrite them
+        PropertyWriters::properties_t& properties = _generators[i].second->propertyWriters().get();
+        for (PropertyWriters::properties_t::const_iterator it = properties.begin(); it != properties.end(); ++it)
+        {
+            anymap_t::iterator ri = data.find(it->first);
+            if (ri == data.end()) continue;
+
+            data[prefix + it->first].swap(ri->second);
+            data.erase(it->first);
+        }
+    }
+}
+
+ImageRequirements MultiGenerator::input_requirements() const
+{
+    ImageRequirements combined(0, 0, true);
+    bool full_resolution = false;
+
+    for (size_t i = 0; i < _generators.size(); i++)
+    {
+        ImageRequirements r = _generators[i].second->input_requirements();
+        full_resolution |= (r.longer_side == 0);
+        combined.longer_side = std::max(combined.longer_side, r.longer_side);
+        combined.shorter_side = std::max(combined.shorter_side, r.shorter_side);
+        combined.grayscale &= r.grayscale;
+    }
+
+    if (full_resolution) combined.longer_side = combined.shorter_side = 0;
+    return combined;
+}
+
+const MultiGenerator::generators_t& MultiGenerator::generators() const
+{
+    return _generators;
+}
+
+} // namespace imdb
@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef MULTI_GENERATOR_HPP
+#define MULTI_GENERATOR_HPP
+
+#include <vector>
+
+#include "../util/types.hpp"
+#include "generator.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup generators
+ * @brief Runs several generators on the same image, such that it is loaded and decoded only once.
+ *
+ * Each generator has a prefix that is prepended to the names of its properties, e.g. the "features"
+ * of a generator with prefix "galif_" are offered as "galif_features" by propertyWriters() and
+ * stored in data under that name by compute(). The generators run one after another on the same data
+ * and share intermediate results: the grayscale image is converted only once and the grayscale image
+ * scaled to a given side length is computed only once for all generators needing that size (see
+ * scaledGrayscaleImage()).
+ *
+ * A MultiGenerator is not registered by name, parameters() contains the parameters of each generator
+ * under its prefix.
+ */
+class MultiGenerator : public Generator
+{
+    public:
+
+    /// prefix and generator
+    typedef std::vector<std::pair<std::string, shared_ptr<Generator> > > generators_t;
+
+    /// @throw std::runtime_error if generators is empty or contains the same prefix twice
+    MultiGenerator(const generators_t& generators);
+
+    void compute(anymap_t& data) const;
+
+    /// Passes each generator its own workspace, contained in workspace
+    void compute(anymap_t& data, Workspace& workspace) const;
+
+    shared_ptr<Workspace> create_workspace() const;
+
+    /// The smallest image that satisfies the requirements of all generators
+    ImageRequirements input_requirements() const;
+
+    const generators_t& generators() const;
+
+    private:
+
+    // the workspaces of all generators, in the same order
+    struct MultiWorkspace : public Workspace
+    {
+        std::vector<shared_ptr<Workspace> > workspaces;
+    };
+
+    static ptree combined_parameters(const generators_t& generators);
+    static PropertyWriters combined_writers(const generators_t& generators);
+
+    generators_t _generators;
+
+    /// at least one generator works on the grayscale image
+    bool _grayscale;
+};
+
+} // namespace imdb
+
+#endif // MULTI_GENERATOR_HPP
@@ -26,14 +26,15 @@ the terms of the BSD license (see the LICENSE file).
 #include "../util/types.hpp"
 #include "shog.hpp"
 #include "utilities.hpp"
+#include "tile_aggregator.hpp"
 
 namespace imdb {
 
 shog_generator::shog_generator(const ptree& params)
     : Generator(params,
                 PropertyWriters()
-                .add<vec_vec_f32_t>("features")
-                .add<vec_vec_f32_t>("positions")
+                .add_local_features("features", params.get<string>("generator.feature_precision", "f32"))
+                .add<RaggedMatrix>("positions")
                 .add<int32_t>("numfeatures") // number of visual words/image
                 )
 
@@ -47,6 +48,10 @@ shog_generator::shog_generator(const ptree& params)
     , _tiles              (parse<uint>  (_parameters, "generator.tiles", 4))
     , _smoothHist         (parse<bool>  (_parameters, "generator.smooth_hist", true))
     , _samplerName        (parse<string>(_parameters, "generator.sampler.name", "grid"))
+    , _tileAggregation    (parse<string>(_parameters, "generator.tile_aggregation", "filter")) // can be "filter" or "integral", see TileAggregator
+    , _tileBoxes          (TileAggregator::checkNumBoxes(parse<uint>(_parameters, "generator.tile_boxes", 4))) // number of boxes approximating the Gaussian with "integral"
+    , _featurePrecision   (parse<string>(_parameters, "generator.feature_precision", "f32")) // "f32", or "f16"/"q8" to store the features in reduced precision
+    , _tileMode           (TileAggregator::parseMode(_tileAggregation))
     , _sampler            (ImageSampler::create(_samplerName))
 {
 
@@ -60,9 +65,18 @@ shog_generator::shog_generator(const ptree& params)
     std::cout << " generator.tiles=" << _tiles << std::endl;
     std::cout << " generator.smooth_hist=" << _smoothHist << std::endl;
     std::cout << " generator.sampler.name=" << _samplerName << std::endl;
+    std::cout << " generator.tile_aggregation=" << _tileAggregation << std::endl;
+    std::cout << " generator.tile_boxes=" << _tileBoxes << std::endl;
+    std::cout << " generator.feature_precision=" << _featurePrecision << std::endl;
 }
 
 
+ImageRequirements shog_generator::input_requirements() const
+{
+    // the image is scaled such that its longer side is _width
+    return ImageRequirements(_width, 0, true);
+}
+
 void shog_generator::compute(anymap_t& data) const
 {
     // --------------------------------------------------------------
@@ -70,6 +84,7 @@ void shog_generator::compute(anymap_t& data) const
     //
     // this generator expects a 3-channel image, with
     // each channel containing exactly the same pixel values
+    // (or a grayscale image_gray, see input_requirements())
     //
     // the image must have a white background with black sketch lines
     // --------------------------------------------------------------
@@ -77,23 +92,18 @@ void shog_generator::compute(anymap_t& data) const
     using namespace std;
     using namespace cv;
 
-    Mat img = get<mat_8uc3_t>(data, "image");
-    Mat imgGray;
-
-    cvtColor(img, imgGray, CV_RGB2GRAY);
+    // scale image to desired size, the scaled image is shared with other
+    // generators working on the same data that need the same size
+    Mat scaled = scaledGrayscaleImage(data, CV_RGB2GRAY, _width);
 
-    assert(imgGray.type() == CV_8UC1);
-
-    // scale image to desired size
-    Mat scaled;
-    scale(imgGray, scaled);
+    assert(scaled.type() == CV_8UC1);
 
     // detect keypoints on the scaled image
     vec_vec_f32_t keypoints;
     detect(scaled, keypoints);
 
     // extract local features at the given keypoints
-    vec_vec_f32_t features;
+    RaggedMatrix features;
     vector<index_t> emptyFeatures;
     extract(scaled, keypoints, features, emptyFeatures);
     assert(features.size() == keypoints.size());
@@ -101,20 +111,20 @@ void shog_generator::compute(anymap_t& data) const
 
     // normalize keypoints to range [0,1]x[0,1] so they are
     // independent of image size
-    vec_vec_f32_t keypointsNormalized;
+    RaggedMatrix keypointsNormalized;
     normalizePositions(keypoints, scaled.size(), keypointsNormalized);
 
     // remove features that are empty, i.e. that contain
     // no sketch stroke within their area
-    vec_vec_f32_t featuresFiltered;
-    vec_vec_f32_t keypointsNormalizedFiltered;
+    RaggedMatrix featuresFiltered;
+    RaggedMatrix keypointsNormalizedFiltered;
     filterEmptyFeatures(features, keypointsNormalized, emptyFeatures, featuresFiltered, keypointsNormalizedFiltered);
     assert(featuresFiltered.size() == keypointsNormalizedFiltered.size());
 
-    // store
-    data["features"] = featuresFiltered;
-    data["positions"] = keypointsNormalizedFiltered;
+    // store, features and positions are moved into data
     data["numfeatures"] = static_cast<int32_t>(featuresFiltered.size());
+    put(data, "features", featuresFiltered);
+    put(data, "positions", keypointsNormalizedFiltered);
 }
 
 void shog_generator::detect(const cv::Mat& image, vec_vec_f32_t& keypoints) const
@@ -129,7 +139,7 @@ double shog_generator::scale(const cv::Mat& image, cv::Mat& scaled) const
 }
 
 
-void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, vec_vec_f32_t& features, vector<index_t>& emptyFeatures) const
+void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, RaggedMatrix& features, vector<index_t>& emptyFeatures) const
 {
     using namespace cv;
 
@@ -250,31 +260,8 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
     float halfTileSize = tileSize / 2.0f;
 
 
-    // spatial smooting
-    for (size_t i = 0; i < _numOrients; i++)
-    {
-        // copy response image centered into a new, larger image that contains an empty border
-        // of size tileSize around all sides. This additional  border is essential to be able to
-        // later compute values outside of the original image bounds
-        cv::Mat framed = cv::Mat::zeros(imageBlurred.rows + 2*tileSize, imageBlurred.cols + 2*tileSize, CV_32FC1);
-        cv::Mat image_rect_in_frame = framed(cv::Rect(tileSize, tileSize, imageBlurred.cols, imageBlurred.rows));
-        orientations[i].copyTo(image_rect_in_frame);
-
-        if (_smoothHist)
-        {
-            int kernelSize = 2 * tileSize + 1;
-            float gaussBlurSigma = tileSize / 3.0;
-            cv::GaussianBlur(framed, framed, cv::Size(kernelSize, kernelSize), gaussBlurSigma, gaussBlurSigma); // TODO: border type?
-        }
-        else
-        {
-            int kernelSize = tileSize;
-            cv::boxFilter(framed, framed, CV_32F, cv::Size(kernelSize, kernelSize), cv::Point(-1, -1), false); // TODO: border type?
-        }
-
-        // response have now size of image + 2*tileSize in each dimension
-        orientations[i] = framed;
-    }
+    // smoothed responses, these are sampled at the tile centers of each feature below
+    TileAggregator tiles(orientations, tileSize, _smoothHist, _tileMode, _tileBoxes);
 
 
     // integral image to be able to easily check whether a region that is
@@ -293,6 +280,10 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
     // as the keypoints and features vector
     emptyFeatures.resize(keypoints.size(), 0);
 
+    // all histograms are stored in a single buffer, reserve it upfront
+    const size_t histogramSize = _tiles * _tiles * _numOrients;
+    features.reserve(features.size() + keypoints.size(), features.num_values() + keypoints.size() * histogramSize);
+
     // collect orientational responses for each keypoint/region
     for (size_t i = 0; i < keypoints.size(); i++)
     {
@@ -300,7 +291,8 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
         const vec_f32_t& keypoint = keypoints[i];
 
         // create histogram: row <-> tile, column <-> histogram of directional responses
-        vec_f32_t histogram(_tiles * _tiles * _numOrients, 0.0f);
+        // the histogram is a zero-filled row in features that is filled in place
+        RaggedMatrix::row histogram = features.append(histogramSize);
 
         // define region of the feature, intersect feature region with original image
         // to determine the overlapping region, we can now make use of the integral image
@@ -318,9 +310,8 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
         if (patchsum == 0)
         {
             // skip this patch. It contains no strokes.
-            // add empty histogram, filled with zeros,
+            // keep the empty histogram, filled with zeros,
             // will be (optionally) filtered in a later descriptor computation step
-            features.push_back(histogram);
             emptyFeatures[i] = 1;
             continue;
         }
@@ -342,7 +333,7 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
                 {
                     // check for out of bounds condition
                     // NOTE: we have added a frame with the size of a tile
-                    if (y < 0 || x < 0 || y >= orientations[k].rows || x >= orientations[k].cols)
+                    if (y < 0 || x < 0 || y >= image.rows + 2*tileSize || x >= image.cols + 2*tileSize)
                     {
                         continue;
                     }
@@ -358,7 +349,7 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
                     assert(tx >= 0 && ty >= 0);
                     assert(tx < static_cast<int>(_tiles) && ty  < static_cast<int>(_tiles));
 
-                    hist(ty, tx, k) = orientations[k].at<float>(y, x);
+                    hist(ty, tx, k) = tiles.sample(k, x - tileSize, y - tileSize);
                 }
             }
         }
@@ -371,9 +362,6 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
         sum = std::sqrt(sum)  + std::numeric_limits<float>::epsilon(); // + eps avoids div by zero
         for (size_t i = 0; i < histogram.size(); i++) histogram[i] /= sum;
 
-
-        // add histogram to the set of local features for that image
-        features.push_back(histogram);
     }
 }
 
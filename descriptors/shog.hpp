@@ -15,6 +15,7 @@ the terms of the BSD license (see the LICENSE file).
 #include "../util/types.hpp"
 #include "../descriptors/generator.hpp"
 #include "image_sampler.hpp"
+#include "tile_aggregator.hpp"
 
 namespace imdb
 {
@@ -31,11 +32,13 @@ class shog_generator : public Generator
 
     void compute(anymap_t& data) const;
 
+    ImageRequirements input_requirements() const;
+
     double scale(const cv::Mat& image, cv::Mat& scaled) const;
 
     void detect(const cv::Mat& image, vec_vec_f32_t& keypoints) const;
 
-    void extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, vec_vec_f32_t& features, vector<index_t> &emptyFeatures) const;
+    void extract(const cv::Mat& image, const vec_vec_f32_t& keypoints, RaggedMatrix& features, vector<index_t> &emptyFeatures) const;
 
     private:
 
@@ -45,6 +48,10 @@ class shog_generator : public Generator
     const uint         _tiles;
     const bool         _smoothHist;
     const string       _samplerName;
+    const string       _tileAggregation;
+    const uint         _tileBoxes;
+    const string       _featurePrecision;
+    const TileAggregator::Mode _tileMode;
 
     shared_ptr<ImageSampler> _sampler;
 };
@@ -0,0 +1,302 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include "simd_kernels.hpp"
+
+// SSE2 is part of x86-64, on 32 bit x86 it has to be enabled (see common.pri)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMDB_SSE2
+#include <emmintrin.h>
+#endif
+
+// the AVX2 versions are compiled for AVX2 using function attributes, such that the rest of the
+// program runs on CPUs without AVX2. This requires GCC >= 4.9 or clang.
+#if defined(IMDB_SSE2) && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define IMDB_AVX2
+#define IMDB_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace imdb {
+
+namespace {
+
+SimdLevel supportedLevel()
+{
+#ifdef IMDB_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdAVX2;
+#endif
+#ifdef IMDB_SSE2
+    return SimdSSE2;
+#else
+    return SimdNone;
+#endif
+}
+
+SimdLevel& currentLevel()
+{
+    static SimdLevel level = supportedLevel();
+    return level;
+}
+
+
+// scalar versions, also process the remaining elements of the vectorized versions
+
+void complexMagnitudeScalar(const float* src, float* dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        float re = src[2*i];
+        float im = src[2*i + 1];
+        dst[i] = std::sqrt(re*re + im*im);
+    }
+}
+
+void u8ToFloatScalar(const uchar* src, float* dst, std::size_t n, float scale)
+{
+    for (std::size_t i = 0; i < n; i++) dst[i] = src[i] * scale;
+}
+
+void u8ToComplexScalar(const uchar* src, float* dst, std::size_t n, double scale)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        dst[2*i] = static_cast<float>(src[i] * scale);
+        dst[2*i + 1] = 0.0f;
+    }
+}
+
+void invertU8Scalar(const uchar* src, uchar* dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++) dst[i] = 255 - src[i];
+}
+
+
+#ifdef IMDB_SSE2
+
+void complexMagnitudeSSE2(const float* src, float* dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(src + 2*i);
+        __m128 b = _mm_loadu_ps(src + 2*i + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+    }
+    complexMagnitudeScalar(src + 2*i, dst + i, n - i);
+}
+
+// converts 16 bytes to four vectors of 4 floats each
+inline void u8ToFloat16SSE2(const uchar* src, __m128 scale, __m128* f)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    f[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale);
+    f[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale);
+    f[2] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale);
+    f[3] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale);
+}
+
+void u8ToFloatSSE2(const uchar* src, float* dst, std::size_t n, float scale)
+{
+    __m128 s = _mm_set1_ps(scale);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128 f[4];
+        u8ToFloat16SSE2(src + i, s, f);
+        for (int k = 0; k < 4; k++) _mm_storeu_ps(dst + i + 4*k, f[k]);
+    }
+    u8ToFloatScalar(src + i, dst + i, n - i, scale);
+}
+
+void u8ToComplexSSE2(const uchar* src, float* dst, std::size_t n, double scale)
+{
+    __m128d s = _mm_set1_pd(scale);
+    __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        // 4 bytes to 4 ints, each pair is scaled in double precision and rounded to float,
+        // the zero upper halves of the conversions are the imaginary parts
+        int bytes;
+        std::memcpy(&bytes, src + i, 4);
+        __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(v), s));
+        __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), s));
+        _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(lo, _mm_setzero_ps()));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpacklo_ps(hi, _mm_setzero_ps()));
+    }
+    u8ToComplexScalar(src + i, dst + 2*i, n - i, scale);
+}
+
+void invertU8SSE2(const uchar* src, uchar* dst, std::size_t n)
+{
+    // 255 - x == x ^ 0xFF for bytes
+    __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, ones));
+    }
+    invertU8Scalar(src + i, dst + i, n - i);
+}
+
+#endif // IMDB_SSE2
+
+
+#ifdef IMDB_AVX2
+
+IMDB_TARGET_AVX2 void complexMagnitudeAVX2(const float* src, float* dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(src + 2*i);
+        __m256 b = _mm256_loadu_ps(src + 2*i + 8);
+
+        // the shuffles work within 128 bit lanes, giving the elements in the order 0 1 4 5 2 3 6 7
+        __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 m = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+        m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(dst + i, m);
+    }
+    complexMagnitudeScalar(src + 2*i, dst + i, n - i);
+}
+
+// converts 8 bytes to a vector of 8 floats
+IMDB_TARGET_AVX2 inline __m256 u8ToFloat8AVX2(const uchar* src, __m256 scale)
+{
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), scale);
+}
+
+IMDB_TARGET_AVX2 void u8ToFloatAVX2(const uchar* src, float* dst, std::size_t n, float scale)
+{
+    __m256 s = _mm256_set1_ps(scale);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(dst + i, u8ToFloat8AVX2(src + i, s));
+    u8ToFloatScalar(src + i, dst + i, n - i, scale);
+}
+
+IMDB_TARGET_AVX2 void u8ToComplexAVX2(const uchar* src, float* dst, std::size_t n, double scale)
+{
+    __m256d s = _mm256_set1_pd(scale);
+    __m256 zero = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // 8 bytes to 8 ints, scaled in double precision 4 at a time and rounded to float
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        __m128 f0 = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), s));
+        __m128 f1 = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), s));
+        __m256 f = _mm256_insertf128_ps(_mm256_castps128_ps256(f0), f1, 1);
+
+        // the unpacks work within 128 bit lanes: lo holds the elements 0 1 4 5, hi 2 3 6 7
+        __m256 lo = _mm256_unpacklo_ps(f, zero);
+        __m256 hi = _mm256_unpackhi_ps(f, zero);
+        _mm256_storeu_ps(dst + 2*i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + 2*i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    u8ToComplexScalar(src + i, dst + 2*i, n - i, scale);
+}
+
+IMDB_TARGET_AVX2 void invertU8AVX2(const uchar* src, uchar* dst, std::size_t n)
+{
+    __m256i ones = _mm256_set1_epi8(static_cast<char>(0xFF));
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(v, ones));
+    }
+    invertU8Scalar(src + i, dst + i, n - i);
+}
+
+#endif // IMDB_AVX2
+
+} // anonymous namespace
+
+
+SimdLevel simdLevel()
+{
+    return currentLevel();
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    SimdLevel supported = supportedLevel();
+    currentLevel() = (level < supported) ? level : supported;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdAVX2: return "avx2";
+        case SimdSSE2: return "sse2";
+        default:       return "none";
+    }
+}
+
+void complexMagnitude(const float* src, float* dst, std::size_t n)
+{
+#ifdef IMDB_AVX2
+    if (currentLevel() == SimdAVX2) return complexMagnitudeAVX2(src, dst, n);
+#endif
+#ifdef IMDB_SSE2
+    if (currentLevel() == SimdSSE2) return complexMagnitudeSSE2(src, dst, n);
+#endif
+    complexMagnitudeScalar(src, dst, n);
+}
+
+void u8ToFloat(const uchar* src, float* dst, std::size_t n, float scale)
+{
+#ifdef IMDB_AVX2
+    if (currentLevel() == SimdAVX2) return u8ToFloatAVX2(src, dst, n, scale);
+#endif
+#ifdef IMDB_SSE2
+    if (currentLevel() == SimdSSE2) return u8ToFloatSSE2(src, dst, n, scale);
+#endif
+    u8ToFloatScalar(src, dst, n, scale);
+}
+
+void u8ToComplex(const uchar* src, float* dst, std::size_t n, double scale)
+{
+#ifdef IMDB_AVX2
+    if (currentLevel() == SimdAVX2) return u8ToComplexAVX2(src, dst, n, scale);
+#endif
+#ifdef IMDB_SSE2
+    if (currentLevel() == SimdSSE2) return u8ToComplexSSE2(src, dst, n, scale);
+#endif
+    u8ToComplexScalar(src, dst, n, scale);
+}
+
+void invertU8(const uchar* src, uchar* dst, std::size_t n)
+{
+#ifdef IMDB_AVX2
+    if (currentLevel() == SimdAVX2) return invertU8AVX2(src, dst, n);
+#endif
+#ifdef IMDB_SSE2
+    if (currentLevel() == SimdSSE2) return invertU8SSE2(src, dst, n);
+#endif
+    invertU8Scalar(src, dst, n);
+}
+
+} // namespace imdb
@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cstddef>
+
+#include "../util/types.hpp"
+
+namespace imdb {
+
+// Pixel loops shared by the Gabor filter based generators (galif, gist). Each kernel has
+// a scalar, an SSE2 and an AVX2 version, the fastest one supported by the CPU is selected
+// at runtime. All versions compute exactly the same results. The kernels work on plain
+// arrays, i.e. on single rows of non-continuous matrices.
+
+enum SimdLevel { SimdNone, SimdSSE2, SimdAVX2 };
+
+// The instruction set used by the kernels
+SimdLevel simdLevel();
+
+// Restricts the kernels to the given instruction set (or the best one supported by the CPU,
+// if that is lower), e.g. to compare the versions. Not thread-safe, call before computing.
+void setSimdLevel(SimdLevel level);
+
+// Name of the instruction set, "none", "sse2" or "avx2"
+const char* simdLevelName(SimdLevel level);
+
+// dst[i] = |src[i]| = sqrt(re^2 + im^2) for n complex numbers stored as interleaved (re, im) pairs
+void complexMagnitude(const float* src, float* dst, std::size_t n);
+
+// dst[i] = src[i] * scale
+void u8ToFloat(const uchar* src, float* dst, std::size_t n, float scale);
+
+// dst[i] = complex(float(src[i] * scale), 0), dst stores interleaved (re, im) pairs, i.e. 2n floats.
+// The product is computed in double precision and rounded to float once.
+void u8ToComplex(const uchar* src, float* dst, std::size_t n, double scale);
+
+// dst[i] = 255 - src[i]
+void invertU8(const uchar* src, uchar* dst, std::size_t n);
+
+} // namespace imdb
+
+#endif // SIMD_KERNELS_HPP
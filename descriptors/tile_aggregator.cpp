@@ -0,0 +1,177 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "tile_aggregator.hpp"
+
+namespace imdb {
+
+TileAggregator::Mode TileAggregator::parseMode(const string& name)
+{
+    if (name == "filter") return TileFilter;
+    if (name == "integral") return TileIntegral;
+    throw std::runtime_error("unknown tile aggregation: " + name + ", use filter or integral");
+}
+
+int TileAggregator::checkNumBoxes(int numBoxes)
+{
+    if (numBoxes < 1) throw std::runtime_error("invalid number of tile boxes, must be at least 1");
+    return numBoxes;
+}
+
+TileAggregator::TileAggregator()
+    : _mode(TileFilter)
+    , _tileSize(0)
+    , _gaussian(false)
+    , _numBoxes(0)
+    , _boxesTileSize(-1)
+{}
+
+TileAggregator::TileAggregator(const std::vector<cv::Mat>& responses, int tileSize, bool gaussian, Mode mode, int numBoxes)
+    : _mode(mode)
+    , _tileSize(tileSize)
+    , _gaussian(gaussian)
+    , _numBoxes(numBoxes)
+    , _boxesTileSize(-1)
+{
+    reset(responses, tileSize, gaussian, mode, numBoxes);
+}
+
+void TileAggregator::reset(const std::vector<cv::Mat>& responses, int tileSize, bool gaussian, Mode mode, int numBoxes)
+{
+    checkNumBoxes(numBoxes);
+
+    _mode = mode;
+    _tileSize = tileSize;
+    _gaussian = gaussian;
+
+    if (_mode == TileFilter)
+    {
+        _framed.resize(responses.size());
+        for (size_t i = 0; i < responses.size(); i++)
+        {
+            // copy response image centered into a new, larger image that contains an empty border
+            // of size tileSize around all sides. This additional  border is essential to be able to
+            // later compute values outside of the original image bounds
+            cv::Mat& framed = _framed[i];
+            framed.create(responses[i].rows + 2*tileSize, responses[i].cols + 2*tileSize, CV_32FC1);
+            framed.setTo(cv::Scalar(0));
+            cv::Mat image_rect_in_frame = framed(cv::Rect(tileSize, tileSize, responses[i].cols, responses[i].rows));
+            responses[i].copyTo(image_rect_in_frame);
+
+            if (_gaussian)
+            {
+                int kernelSize = 2 * tileSize + 1;
+                float gaussBlurSigma = tileSize / 3.0;
+
+                // TODO: border type?
+                cv::GaussianBlur(framed, framed, cv::Size(kernelSize, kernelSize), gaussBlurSigma, gaussBlurSigma);
+            }
+            else
+            {
+                int kernelSize = tileSize;
+
+                // TODO: border type?
+                cv::boxFilter(framed, framed, CV_32F, cv::Size(kernelSize, kernelSize), cv::Point(-1, -1), false);
+            }
+        }
+        return;
+    }
+
+    // the border of the framed images is 0, so the sums need no frame. Accumulate
+    // in double precision, single precision loses too many digits over the image.
+    _sums.resize(responses.size());
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        cv::integral(responses[i], _sums[i], CV_64F);
+    }
+
+    if (!_gaussian || (tileSize == _boxesTileSize && numBoxes == _numBoxes)) return;
+
+    // Approximate the 1D Gaussian kernel by a staircase: step j covers the distances (r_j-1, r_j]
+    // from the center and has the mean height of the kernel over these distances, which keeps
+    // the sum of the kernel. The staircase is the sum of the boxes [-r_j, r_j], each weighted by
+    // the difference to the next step, the 2D kernel is the product of two staircases.
+    cv::Mat kernel = cv::getGaussianKernel(2*tileSize + 1, tileSize / 3.0, CV_64F);
+    _radii.clear();
+    _weights.clear();
+    int prev = -1;
+    for (int j = 1; j <= numBoxes; j++)
+    {
+        int r = static_cast<int>(std::floor(static_cast<double>(tileSize) * j / numBoxes + 0.5));
+        if (r <= prev) continue;
+
+        double sum = 0;
+        int n = 0;
+        for (int d = prev + 1; d <= r; d++)
+        {
+            sum += kernel.at<double>(tileSize + d);
+            n++;
+            if (d > 0)
+            {
+                sum += kernel.at<double>(tileSize - d);
+                n++;
+            }
+        }
+
+        // the height of the step, turned into the weight of its box below
+        _radii.push_back(r);
+        _weights.push_back(sum / n);
+        prev = r;
+    }
+
+    for (size_t j = 0; j < _weights.size(); j++)
+    {
+        _weights[j] -= (j + 1 < _weights.size() ? _weights[j + 1] : 0.0);
+    }
+
+    _boxesTileSize = tileSize;
+    _numBoxes = numBoxes;
+}
+
+float TileAggregator::sample(std::size_t k, int x, int y) const
+{
+    if (_mode == TileFilter) return _framed[k].at<float>(y + _tileSize, x + _tileSize);
+
+    if (!_gaussian)
+    {
+        // the same window as cv::boxFilter with the anchor in the center
+        int x0 = x - _tileSize / 2;
+        int y0 = y - _tileSize / 2;
+        return boxSum(k, x0, y0, x0 + _tileSize - 1, y0 + _tileSize - 1);
+    }
+
+    double sum = 0;
+    for (size_t j = 0; j < _radii.size(); j++)
+        for (size_t l = 0; l < _radii.size(); l++)
+        {
+            sum += _weights[j] * _weights[l] * boxSum(k, x - _radii[j], y - _radii[l], x + _radii[j], y + _radii[l]);
+        }
+    return sum;
+}
+
+double TileAggregator::boxSum(std::size_t k, int x0, int y0, int x1, int y1) const
+{
+    const cv::Mat_<double>& s = _sums[k];
+
+    // the summed-area table has one row and column more than the image
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1 + 1, s.cols - 1);
+    y1 = std::min(y1 + 1, s.rows - 1);
+    if (x0 >= x1 || y0 >= y1) return 0;
+
+    return s(y1, x1) - s(y0, x1) - s(y1, x0) + s(y0, x0);
+}
+
+} // namespace imdb
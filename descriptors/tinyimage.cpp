@@ -6,6 +6,8 @@ This file is part of the imdb library and is made available under
 the terms of the BSD license (see the LICENSE file).
 */
 
+#include <algorithm>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -16,12 +18,23 @@ the terms of the BSD license (see the LICENSE file).
 namespace imdb {
 
 tinyimage_generator::tinyimage_generator(const ptree& params)
- : Generator(params, PropertyWriters().add<vec_f32_t>("features")),
+ // dense and reduced precision feature files are opt-in, existing readers expect vec_f32_t property files
+ : Generator(params, PropertyWriters().add_vectors("features", params.get<bool>("generator.dense_features", false), params.get<string>("generator.feature_precision", "f32"))),
  _width (parse<size_t>(_parameters, "generator.width" ,     16)), //width of thumbnail
  _height(parse<size_t>(_parameters, "generator.height",     16)), // height of thumbnail
- _colorspace(parse<string>  (_parameters, "generator.colorspace", "lab"))
+ _colorspace(parse<string>  (_parameters, "generator.colorspace", "lab")),
+ _dense_features(parse<bool>(_parameters, "generator.dense_features", false)), // write features as a dense matrix (see DensePropertyWriter)
+ _feature_precision(parse<string>(_parameters, "generator.feature_precision", "f32")) // f32, or f16/q8 to store the features in reduced precision
 {}
 
+ImageRequirements tinyimage_generator::input_requirements() const
+{
+    // the image is resized (non-uniformly) to _width x _height, the colorspace conversion
+    // below always works on the color image
+    int side = static_cast<int>(std::max(_width, _height));
+    return ImageRequirements(side, side, false);
+}
+
 void tinyimage_generator::compute(anymap_t& data) const
 {
 
@@ -75,7 +88,7 @@ void tinyimage_generator::compute(anymap_t& data) const
         }
     }
 
-    data["features"] = features;
+    put(data, "features", features);
 }
 
 bool tinyimage_registered = Generator::register_generator<tinyimage_generator>("tinyimage");
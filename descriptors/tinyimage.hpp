@@ -38,11 +38,15 @@ class tinyimage_generator : public Generator
 
     void compute(anymap_t& data) const;
 
+    ImageRequirements input_requirements() const;
+
     private:
 
     const std::size_t _width;
     const std::size_t _height;
     const std::string _colorspace;
+    const bool        _dense_features;
+    const std::string _feature_precision;
 };
 
 } // namespace imdb
@@ -9,6 +9,7 @@ the terms of the BSD license (see the LICENSE file).
 #include "utilities.hpp"
 
 #include <numeric>
+#include <algorithm>
 #include <opencv2/imgproc/imgproc.hpp>
 
 namespace imdb {
@@ -27,6 +28,24 @@ void filterEmptyFeatures(const vec_vec_f32_t& features, const vec_vec_f32_t& key
     }
 }
 
+void filterEmptyFeatures(const RaggedMatrix& features, const RaggedMatrix& keypoints, const vector<index_t>& emptyFeatures, RaggedMatrix& featuresFiltered, RaggedMatrix& keypointsFiltered)
+{
+    assert(features.size() == keypoints.size());
+    assert(features.size() == emptyFeatures.size());
+
+    size_t numKept = std::count(emptyFeatures.begin(), emptyFeatures.end(), 0);
+    featuresFiltered.reserve(featuresFiltered.size() + numKept, featuresFiltered.num_values() + features.num_values());
+    keypointsFiltered.reserve(keypointsFiltered.size() + numKept, keypointsFiltered.num_values() + keypoints.num_values());
+
+    for (size_t i = 0; i < emptyFeatures.size(); i++) {
+
+        if (!emptyFeatures[i]) {
+            featuresFiltered.push_back(features[i]);
+            keypointsFiltered.push_back(keypoints[i]);
+        }
+    }
+}
+
 void normalizePositions(const vec_vec_f32_t& keypoints, const cv::Size& imageSize, vec_vec_f32_t& keypointsNormalized) {
 
     vec_f32_t p(2);
@@ -37,6 +56,26 @@ void normalizePositions(const vec_vec_f32_t& keypoints, const cv::Size& imageSiz
     }
 }
 
+void normalizePositions(const vec_vec_f32_t& keypoints, const cv::Size& imageSize, RaggedMatrix& keypointsNormalized) {
+
+    keypointsNormalized.reserve(keypointsNormalized.size() + keypoints.size(), keypointsNormalized.num_values() + 2*keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); i++) {
+        RaggedMatrix::row p = keypointsNormalized.append(2);
+        p[0] = keypoints[i][0] / imageSize.width;
+        p[1] = keypoints[i][1] / imageSize.height;
+    }
+}
+
+
+cv::Mat grayscaleImage(const anymap_t& data, int code)
+{
+    anymap_t::const_iterator it = data.find("image_gray");
+    if (it != data.end()) return boost::any_cast<const mat_8uc1_t&>(it->second);
+
+    cv::Mat gray;
+    cv::cvtColor(get<mat_8uc3_t>(data, "image"), gray, code);
+    return gray;
+}
 
 double scaleToSideLength(const cv::Mat& image, int maxSideLength, cv::Mat& scaled)
 {
@@ -50,5 +89,22 @@ double scaleToSideLength(const cv::Mat& image, int maxSideLength, cv::Mat& scale
     return scaling_factor;
 }
 
+cv::Mat scaledGrayscaleImage(anymap_t& data, int code, int maxSideLength)
+{
+    // without image_gray the result depends on the color conversion code, don't share it then
+    bool shared = data.count("image_gray") > 0;
+    string key = "image_gray_" + boost::lexical_cast<string>(maxSideLength);
+
+    if (shared)
+    {
+        anymap_t::const_iterator it = data.find(key);
+        if (it != data.end()) return boost::any_cast<const mat_8uc1_t&>(it->second);
+    }
+
+    cv::Mat scaled;
+    scaleToSideLength(grayscaleImage(data, code), maxSideLength, scaled);
+    if (shared) data[key] = mat_8uc1_t(scaled);
+    return scaled;
 }
 
+}
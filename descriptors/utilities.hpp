@@ -10,20 +10,36 @@ the terms of the BSD license (see the LICENSE file).
 #define UTILITIES_HPP
 
 #include "../util/types.hpp"
+#include "../util/ragged_matrix.hpp"
 
 namespace imdb {
 
 // Removes all empty features, i.e. those that only contains zeros
 void filterEmptyFeatures(const vec_vec_f32_t& features, const vec_vec_f32_t& keypoints, const vector<index_t>& emptyFeatures, vec_vec_f32_t& featuresFiltered, vec_vec_f32_t& keypointsFiltered);
 
+// Same as above for features and keypoints stored in a RaggedMatrix, the filtered rows are appended
+void filterEmptyFeatures(const RaggedMatrix& features, const RaggedMatrix& keypoints, const vector<index_t>& emptyFeatures, RaggedMatrix& featuresFiltered, RaggedMatrix& keypointsFiltered);
+
 
 // Normalizes keypoint coordinates into range [0, 1] x [0, 1] to have them stored independently of image size
 void normalizePositions(const vec_vec_f32_t &keypoints, const cv::Size& imageSize, vec_vec_f32_t& keypointsNormalized);
+void normalizePositions(const vec_vec_f32_t &keypoints, const cv::Size& imageSize, RaggedMatrix& keypointsNormalized);
+
+// Returns the grayscale input image of a generator: "image_gray" if the loader has decoded the
+// image as grayscale (see Generator::input_requirements()), otherwise "image" converted using
+// the given cv::cvtColor code, e.g. CV_BGR2GRAY
+cv::Mat grayscaleImage(const anymap_t& data, int code);
 
 // Uniformly scale the image such that the longer of its sides is
 // scaled to exactly maxSideLength, the other one <= maxSideLength
 double scaleToSideLength(const cv::Mat& image, int maxSideLength, cv::Mat& scaled);
 
+// Returns the grayscale input image (see grayscaleImage()) scaled with scaleToSideLength(). If data
+// contains "image_gray", the result is stored in data as "image_gray_<maxSideLength>" such that other
+// generators working on the same data (see MultiGenerator) reuse it instead of scaling again. The
+// returned image is shared and must not be modified.
+cv::Mat scaledGrayscaleImage(anymap_t& data, int code, int maxSideLength);
+
 } // namespace imdb
 
 #endif // UTILITIES_HPP
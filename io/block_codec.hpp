@@ -0,0 +1,276 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef BLOCK_CODEC_HPP
+#define BLOCK_CODEC_HPP
+
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+#include "../util/types.hpp"
+#include "../util/registry.hpp"
+
+#ifdef IMDB_ZLIB
+#include <zlib.h>
+#endif
+
+namespace imdb {
+
+/**
+ * @ingroup io
+ * @brief Interface for the codecs used to compress the blocks of a block-compressed property file.
+ *
+ * Codecs are registered by name (similar to Generator and ImageSampler), the name is stored in
+ * the file such that PropertyReaderT can create the matching codec. Built-in codecs:
+ * - "none": stores blocks uncompressed
+ * - "shuffle": byte-shuffle followed by zero-run encoding, very fast and well suited for sparse float data
+ * - "zlib": byte-shuffle followed by deflate, only available when compiled with IMDB_ZLIB (CONFIG += zlib)
+ */
+class BlockCodec
+{
+public:
+
+    typedef map<string, function<shared_ptr<BlockCodec> ()> > codecs_t;
+
+    template <class codec_t>
+    static inline bool register_codec(const string& name)
+    {
+        codecs_t& codecs = registry().get<codecs_t>("codecs");
+        codecs[name] = boost::bind(create<codec_t>);
+        return true;
+    }
+
+    /// @throw std::runtime_error if no codec with that name has been registered
+    static inline shared_ptr<BlockCodec> create(const std::string& name)
+    {
+        register_builtin_codecs();
+
+        codecs_t& codecs = registry().get<codecs_t>("codecs");
+        codecs_t::const_iterator cit = codecs.find(name);
+        if (cit == codecs.end())
+        {
+            throw std::runtime_error("imdb::BlockCodec: no codec with name '" + name + "' registered.");
+        }
+
+        return cit->second();
+    }
+
+    virtual ~BlockCodec() {}
+
+    /// Compresses size bytes starting at src, the result replaces the content of dst
+    virtual void encode(const char* src, std::size_t size, std::vector<char>& dst) const = 0;
+
+    /// Decompresses size bytes starting at src into dst, dst_size is the uncompressed size
+    virtual void decode(const char* src, std::size_t size, char* dst, std::size_t dst_size) const = 0;
+
+private:
+
+    template <class codec_t>
+    static shared_ptr<BlockCodec> create()
+    {
+        return boost::make_shared<codec_t>();
+    }
+
+    static void register_builtin_codecs();
+};
+
+
+/**
+ * @ingroup io
+ * @brief Stores blocks as they are.
+ */
+class none_codec : public BlockCodec
+{
+public:
+
+    void encode(const char* src, std::size_t size, std::vector<char>& dst) const
+    {
+        dst.assign(src, src + size);
+    }
+
+    void decode(const char* src, std::size_t size, char* dst, std::size_t dst_size) const
+    {
+        if (size != dst_size) throw std::runtime_error("none_codec: corrupt block");
+        if (size > 0) std::memcpy(dst, src, size);
+    }
+};
+
+
+/**
+ * @ingroup io
+ * @brief Byte-shuffle followed by zero-run encoding.
+ *
+ * Shuffling groups the first bytes of all 4-byte words, then all second bytes and so on. For float
+ * data this puts the (similar) exponent bytes next to each other and turns every zero float into
+ * four zero bytes in the separate planes. The shuffled data is then stored as a sequence of
+ * (number of literal bytes, literal bytes, number of zero bytes) tuples, counts being varints.
+ */
+class shuffle_codec : public BlockCodec
+{
+public:
+
+    void encode(const char* src, std::size_t size, std::vector<char>& dst) const
+    {
+        std::vector<char> shuffled(size);
+        shuffle(src, size, shuffled.empty() ? 0 : &shuffled[0]);
+
+        dst.clear();
+        dst.reserve(size / 2);
+
+        std::size_t i = 0;
+        while (i < size)
+        {
+            // literals extend up to the next run of at least min_run zero bytes
+            std::size_t j = i;
+            std::size_t zeros = 0;
+            while (j < size)
+            {
+                zeros = 0;
+                while (j + zeros < size && shuffled[j + zeros] == 0) zeros++;
+                if (zeros >= min_run || j + zeros == size) break;
+
+                // short run of zeros followed by a non-zero byte, both become literals
+                j += zeros + 1;
+                zeros = 0;
+            }
+
+            write_varint(dst, j - i);
+            dst.insert(dst.end(), shuffled.begin() + i, shuffled.begin() + j);
+            write_varint(dst, zeros);
+
+            i = j + zeros;
+        }
+    }
+
+    void decode(const char* src, std::size_t size, char* dst, std::size_t dst_size) const
+    {
+        std::vector<char> shuffled(dst_size);
+
+        const char* p   = src;
+        const char* end = src + size;
+        std::size_t i   = 0;
+        while (p < end)
+        {
+            std::size_t literals = read_varint(p, end);
+            if (literals > static_cast<std::size_t>(end - p) || i + literals > dst_size) throw std::runtime_error("shuffle_codec: corrupt block");
+            if (literals > 0) std::memcpy(&shuffled[i], p, literals);
+            p += literals;
+            i += literals;
+
+            std::size_t zeros = read_varint(p, end);
+            if (i + zeros > dst_size) throw std::runtime_error("shuffle_codec: corrupt block");
+            std::fill(shuffled.begin() + i, shuffled.begin() + i + zeros, 0);
+            i += zeros;
+        }
+        if (i != dst_size) throw std::runtime_error("shuffle_codec: corrupt block");
+
+        unshuffle(shuffled.empty() ? 0 : &shuffled[0], dst_size, dst);
+    }
+
+    /// Shuffles the bytes of all complete 4-byte words, trailing bytes are copied
+    static void shuffle(const char* src, std::size_t size, char* dst)
+    {
+        std::size_t n = size / width;
+        for (std::size_t b = 0; b < width; b++)
+            for (std::size_t i = 0; i < n; i++) dst[b*n + i] = src[i*width + b];
+        for (std::size_t i = n*width; i < size; i++) dst[i] = src[i];
+    }
+
+    static void unshuffle(const char* src, std::size_t size, char* dst)
+    {
+        std::size_t n = size / width;
+        for (std::size_t b = 0; b < width; b++)
+            for (std::size_t i = 0; i < n; i++) dst[i*width + b] = src[b*n + i];
+        for (std::size_t i = n*width; i < size; i++) dst[i] = src[i];
+    }
+
+private:
+
+    static const std::size_t width   = 4;
+    static const std::size_t min_run = 4;
+
+    static void write_varint(std::vector<char>& dst, std::size_t v)
+    {
+        while (v >= 0x80)
+        {
+            dst.push_back(static_cast<char>((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        dst.push_back(static_cast<char>(v));
+    }
+
+    static std::size_t read_varint(const char*& p, const char* end)
+    {
+        std::size_t v = 0;
+        for (int shift = 0; p < end; shift += 7)
+        {
+            unsigned char c = static_cast<unsigned char>(*p++);
+            v |= static_cast<std::size_t>(c & 0x7f) << shift;
+            if (!(c & 0x80)) return v;
+        }
+        throw std::runtime_error("shuffle_codec: corrupt block");
+    }
+};
+
+
+#ifdef IMDB_ZLIB
+/**
+ * @ingroup io
+ * @brief Byte-shuffle (see shuffle_codec) followed by zlib's deflate.
+ */
+class zlib_codec : public BlockCodec
+{
+public:
+
+    void encode(const char* src, std::size_t size, std::vector<char>& dst) const
+    {
+        std::vector<char> shuffled(size);
+        shuffle_codec::shuffle(src, size, shuffled.empty() ? 0 : &shuffled[0]);
+
+        uLongf n = compressBound(size);
+        dst.resize(n);
+        if (compress2(reinterpret_cast<Bytef*>(&dst[0]), &n, reinterpret_cast<const Bytef*>(shuffled.empty() ? 0 : &shuffled[0]), size, Z_DEFAULT_COMPRESSION) != Z_OK)
+        {
+            throw std::runtime_error("zlib_codec: compression failed");
+        }
+        dst.resize(n);
+    }
+
+    void decode(const char* src, std::size_t size, char* dst, std::size_t dst_size) const
+    {
+        std::vector<char> shuffled(dst_size);
+
+        uLongf n = dst_size;
+        if (uncompress(reinterpret_cast<Bytef*>(shuffled.empty() ? 0 : &shuffled[0]), &n, reinterpret_cast<const Bytef*>(src), size) != Z_OK || n != dst_size)
+        {
+            throw std::runtime_error("zlib_codec: corrupt block");
+        }
+
+        shuffle_codec::unshuffle(shuffled.empty() ? 0 : &shuffled[0], dst_size, dst);
+    }
+};
+#endif
+
+
+inline void BlockCodec::register_builtin_codecs()
+{
+    static bool registered = register_codec<none_codec>("none")
+                          && register_codec<shuffle_codec>("shuffle")
+#ifdef IMDB_ZLIB
+                          && register_codec<zlib_codec>("zlib")
+#endif
+                          ;
+    (void)registered;
+}
+
+} // namespace imdb
+
+#endif // BLOCK_CODEC_HPP
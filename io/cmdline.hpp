@@ -144,6 +144,18 @@ class CmdOption
         return found;
     }
 
+    /**
+     * @brief Checks whether a flag, i.e. an option without parameters, has been given.
+     */
+    bool is_set(const std::vector<std::string>& args)
+    {
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (match(args[i])) return true;
+        }
+        return false;
+    }
+
     bool match(const std::string& arg)
     {
         return ((is_short_option(arg) && arg.compare(1, arg.length()-1, _short_option) == 0) ||
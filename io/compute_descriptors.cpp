@@ -1,39 +1,77 @@
 
-#include <opencv2/highgui/highgui.hpp>
-
 #include "compute_descriptors.hpp"
+#include "image_loader.hpp"
+
+#include <cstdio>
 
 using namespace imdb;
 
 ComputeDescriptors::ComputeDescriptors(boost::shared_ptr<Generator> generator, const FileList& files)
     : _generator(generator)
     , _files(files)
+    , _requirements(generator->input_requirements())
     , _index(0)
+    , _first(0)
     , _error(false)
     , _started(false)
     , _finished(false)
+    , _active_decoders(0)
+    , _active_workers(0)
+    , _seconds(0)
+    , _start_us(0)
 {}
 
-void ComputeDescriptors::add_writer(const std::string& name, boost::shared_ptr<PropertyWriter> writer)
+void ComputeDescriptors::add_writer(const std::string& name, boost::shared_ptr<PropertyWriter> writer, size_t checkpoint_interval,
+                                    size_t max_buffered, WriteMode mode)
 {
-    _writers.push_back(std::make_pair(name, boost::make_shared<OrderedPushBack>(writer)));
+    _writers.push_back(std::make_pair(name, boost::shared_ptr<OrderedPushBack>(new OrderedPushBack(writer, checkpoint_interval, max_buffered, mode))));
 }
 
-bool ComputeDescriptors::start(int num_threads)
+bool ComputeDescriptors::start(int num_threads, int num_decode_threads, int num_write_threads)
 {
     assert(num_threads > 0);
+    assert(num_decode_threads >= 0 && num_write_threads >= 0);
     using namespace boost;
 
     if (_started) return false;
 
     _started = true;
     _datetime = QDateTime::currentDateTime();
+    _start_us = now_us();
+
+    // skip everything that all writers already contain
+    size_t first = _writers.empty() ? 0 : _files.size();
+    for (size_t i = 0; i < _writers.size(); i++)
+    {
+        first = std::min(first, _writers[i].second->num_written());
+    }
+
+    {
+        // metrics() might already look at the queues
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _index = _first = first;
+
+        // the queues hold a few items per consuming thread, enough to
+        // smooth out varying processing times of single images
+        if (num_decode_threads > 0) _decoded.reset(new bounded_queue<item_t>(2 * num_threads));
+        if (num_write_threads > 0) _computed.reset(new bounded_queue<item_t>(2 * num_write_threads));
+        _active_decoders = num_decode_threads;
+        _active_workers = num_threads;
+    }
 
     thread_group pool;
+    for (int i = 0; i < num_decode_threads; i++)
+    {
+        pool.add_thread(new thread(std::mem_fun(&ComputeDescriptors::_decode_thread), this));
+    }
     for (int i = 0; i < num_threads; i++)
     {
         pool.add_thread(new thread(std::mem_fun(&ComputeDescriptors::_thread), this, _generator));
     }
+    for (int i = 0; i < num_write_threads; i++)
+    {
+        pool.add_thread(new thread(std::mem_fun(&ComputeDescriptors::_write_thread), this));
+    }
 
     pool.join_all();
 
@@ -45,6 +83,33 @@ bool ComputeDescriptors::start(int num_threads)
         _error |= !_writers[i].second->empty_buffer();
     }
 
+    if (_cache)
+    {
+        try
+        {
+            _cache->close();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "compute_descriptors: " << e.what() << std::endl;
+            _error = true;
+        }
+    }
+
+    // writers might be asynchronous, make sure everything has reached the disk
+    for (size_t i = 0; i < _writers.size(); i++)
+    {
+        try
+        {
+            _writers[i].second->close();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "compute_descriptors: writing property " << _writers[i].first << " failed: " << e.what() << std::endl;
+            _error = true;
+        }
+    }
+
     return (!_error);
 }
 
@@ -64,63 +129,318 @@ index_t ComputeDescriptors::num_files() const
     return _files.size();
 }
 
+const FileList& ComputeDescriptors::files() const
+{
+    return _files;
+}
+
 int ComputeDescriptors::computation_time() const
 {
     // precondition: finished() == true
     return _seconds;
 }
 
-void ComputeDescriptors::_thread(boost::shared_ptr<Generator> gen)
+void ComputeDescriptors::set_cache(boost::shared_ptr<DescriptorCache> cache)
 {
-    while (!_error)
+    _cache = cache;
+}
+
+void ComputeDescriptors::set_num_slowest(size_t num_slowest)
+{
+    _stats.set_num_slowest(num_slowest);
+}
+
+const ComputeStats& ComputeDescriptors::stats() const
+{
+    return _stats;
+}
+
+void ComputeDescriptors::metrics(ptree& pt) const
+{
+    size_t done;
+    double seconds = 0;
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        done = _index;
+        if (_started) seconds = (now_us() - _start_us) * 1e-6;
+
+        pt.put("queues.decoded.size", _decoded ? _decoded->size() : 0);
+        pt.put("queues.decoded.capacity", _decoded ? _decoded->capacity() : 0);
+        pt.put("queues.computed.size", _computed ? _computed->size() : 0);
+        pt.put("queues.computed.capacity", _computed ? _computed->capacity() : 0);
+    }
+
+    // note that done counts the files that have been started
+    pt.put("files.total", _files.size());
+    pt.put("files.first", _first);
+    pt.put("files.done", done);
+    pt.put("finished", _finished);
+    char buffer[32];
+    std::sprintf(buffer, "%.1f", seconds);
+    pt.put("elapsed_s", buffer);
+    std::sprintf(buffer, "%.2f", seconds > 0 ? (done - _first) / seconds : 0.0);
+    pt.put("files_per_s", buffer);
+
+    for (size_t i = 0; i < _writers.size(); i++)
+    {
+        // writer names may contain the path separator of ptree
+        ptree& w = pt.put_child(ptree::path_type("writers", '\0') / ptree::path_type(_writers[i].first, '\0'), ptree());
+        w.put("written", _writers[i].second->num_written());
+        w.put("buffered", _writers[i].second->num_buffered());
+    }
+
+    _stats.stages_to_ptree(pt.put_child("stages", ptree()));
+
+    if (_cache)
+    {
+        pt.put("cache.path", _cache->path());
+        pt.put("cache.entries", _cache->size());
+        pt.put("cache.hits", _stats.cache_hits());
+        pt.put("cache.misses", _stats.cache_misses());
+    }
+
+    ptree& slowest = pt.put_child("slowest", ptree());
+    std::vector<ComputeStats::file_time_t> files = _stats.slowest();
+    for (size_t i = 0; i < files.size(); i++)
     {
-        size_t current;
-        anymap_t data;
+        ptree f;
+        f.put("index", files[i].second);
+        f.put("file", _files.get_filename(files[i].second));
+        f.put("us", files[i].first);
+        slowest.push_back(std::make_pair("", f));
+    }
+}
 
+bool ComputeDescriptors::next_index(size_t& index, ComputeStats::ThreadStats& stats)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        if (_error || _index == _files.size()) return false;
+        index = _index;
+        _index++;
+    }
+
+    // wait until the writers have room for the result, waiting before the computation instead
+    // of in push_back() makes sure that the thread holding the next element to be written is
+    // never blocked, no matter how the results travel through the stages
+    uint64_t t0 = now_us();
+    for (size_t i = 0; i < _writers.size(); i++)
+    {
+        if (!_writers[i].second->wait_writable(index)) return false;
+    }
+    stats.add(StageWait, now_us() - t0);
+    return true;
+}
+
+void ComputeDescriptors::decode(item_t& item, ComputeStats::ThreadStats& stats) const
+{
+    anymap_t& data = *item.data;
+    string filename = _files.get_filename(item.index);
+    data["image_filename"] = filename;
+
+    // with a key from the file's stat, files in the cache are not even read
+    uint64_t t0 = now_us();
+    if (_cache && _cache->mode() == DescriptorCache::KeyStat)
+    {
+        item.key = DescriptorCache::stat_key(filename);
+        item.cached = _cache->lookup(item.key, data);
+
+        uint64_t t = now_us();
+        stats.add(StageCache, t - t0);
+        stats.add_cache_lookup(item.cached);
+        item.us = t - t0;
+        if (item.cached) return;
+    }
+
+    // Depending on the generator's input requirements, the image is decoded at a
+    // reduced resolution and/or as grayscale image. Color images are forced to have
+    // 3 channels.
+    //
+    // Although this is not explicitly stated in the OpenCV docs, the channel
+    // order is BGR, this has been tested by Mathias 08.June.2011 for both png
+    // and jpg images. I.e. the following code
+    // cv::Mat img = cv::imread("/Users/admin/tmp/blue.jpg");
+    // cv::Vec3b v = img.at<cv::Vec3b>(0,0);
+    // will result in the blue information at v[0], green at v[1] and red at v[2]
+    uint64_t t1 = now_us();
+    std::vector<uchar> buffer;
+    read_file(filename, buffer);
+
+    uint64_t t2 = now_us();
+    stats.add(StageRead, t2 - t1);
+
+    if (_cache && _cache->mode() == DescriptorCache::KeyContent)
+    {
+        item.key = DescriptorCache::content_key(buffer);
+        item.cached = _cache->lookup(item.key, data);
+
+        uint64_t t = now_us();
+        stats.add(StageCache, t - t2);
+        stats.add_cache_lookup(item.cached);
+        if (item.cached)
         {
-            boost::lock_guard<boost::mutex> lock(_mutex);
-            if (_index == _files.size()) break;
-            current = _index;
-            _index++;
+            item.us = t - t0;
+            return;
+        }
+        t2 = t;
+    }
+
+    bool okay;
+    try
+    {
+        okay = decode_image(buffer, _requirements, data);
+    }
+
+    catch(cv::Exception& e)
+    {
+        okay = false;
+    }
+
+    // the original opencv exception message is very poor -- make it more clear
+    // and more importantly give the problematic filename
+    if (!okay) throw std::runtime_error("compute_descriptors: decoding failed for file: " + filename);
+
+    uint64_t t3 = now_us();
+    stats.add(StageDecode, t3 - t2);
+    item.us = t3 - t0;
+}
 
+void ComputeDescriptors::write(size_t index, anymap_t& data, ComputeStats::ThreadStats& stats)
+{
+    // the results are moved into the writers' buffers, i.e. each result is only
+    // copied once more, when serialized by the writer
+    uint64_t t0 = now_us();
+    for (std::vector<string_writer_pair>::const_iterator wi = _writers.begin(); wi != _writers.end(); ++wi)
+    {
+        anymap_t::iterator ri = data.find(wi->first);
+        if (ri != data.end()) wi->second->push_back(index, ri->second);
+    }
+    stats.add(StageWrite, now_us() - t0);
+}
+
+void ComputeDescriptors::fail(const std::string& message)
+{
+    std::cerr << message << std::endl;
+    _error = true;
+
+    // wake up all threads blocked on one of the queues or writers
+    if (_decoded) _decoded->close();
+    if (_computed) _computed->close();
+    for (size_t i = 0; i < _writers.size(); i++) _writers[i].second->cancel();
+}
+
+void ComputeDescriptors::_decode_thread()
+{
+    ComputeStats::ThreadStats& stats = _stats.add_thread();
+
+    item_t item;
+    while (next_index(item.index, stats))
+    {
+        item.data.reset(new anymap_t());
+
+        try
+        {
+            decode(item, stats);
+        }
+        catch (std::exception& e)
+        {
+            fail(e.what());
+            break;
         }
 
-        string filename = _files.get_filename(current);
+        if (!_decoded->push(item)) break;
+    }
+
+    // the last decode thread tells the compute threads that no more images will come
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (--_active_decoders == 0) _decoded->close();
+}
+
+void ComputeDescriptors::_thread(boost::shared_ptr<Generator> gen)
+{
+    ComputeStats::ThreadStats& stats = _stats.add_thread();
+
+    // buffers of the generator, reused for all images computed by this thread
+    boost::shared_ptr<Generator::Workspace> workspace = gen->create_workspace();
+
+    while (!_error)
+    {
+        item_t item;
+
+        if (_decoded)
+        {
+            if (!_decoded->pop(item)) break;
+        }
+        else
+        {
+            if (!next_index(item.index, stats)) break;
+            item.data.reset(new anymap_t());
+        }
 
         try
         {
-            // second parmeter: flags >0 means that the loaded image is forced to be a 3-channel color image
-            //
-            // Although this is not explicitly stated in the OpenCV docs, the channel
-            // order is BGR, this has been tested by Mathias 08.June.2011 for both png
-            // and jpg images. I.e. the following code
-            // cv::Mat img = cv::imread("/Users/admin/tmp/blue.jpg");
-            // cv::Vec3b v = img.at<cv::Vec3b>(0,0);
-            // will result in the blue information at v[0], green at v[1] and red at v[2]
-            mat_8uc3_t image = cv::imread(filename, 1);
-            data["image"] = image;
-            data["image_filename"] = filename;
-            gen->compute(data);
+            if (!_decoded) decode(item, stats);
+
+            if (!item.cached)
+            {
+                uint64_t t0 = now_us();
+                gen->compute(*item.data, *workspace);
+                uint64_t t1 = now_us();
+
+                stats.add(StageCompute, t1 - t0);
+                stats.add_file(item.index, item.us + t1 - t0);
+
+                // store the results before the writers take them over
+                if (_cache)
+                {
+                    _cache->insert(item.key, *item.data);
+                    stats.add(StageCache, now_us() - t1);
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            fail(e.what());
+            break;
         }
 
-        catch(cv::Exception& e)
+        if (_computed)
         {
-            // the original opencv exception message is very poor -- make it more clear
-            // and more importantly give the problematic filename
-            throw std::runtime_error("compute_descriptors: cv::imread failed for file: " + filename);
+            if (!_computed->push(item)) break;
+            continue;
         }
 
+        try
+        {
+            write(item.index, *item.data, stats);
+        }
         catch (std::exception& e)
         {
-            std::cerr << e.what() << std::endl;
-            _error = true;
-            return;
+            fail(e.what());
+            break;
         }
+    }
+
+    // the last compute thread tells the write threads that no more results will come
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (--_active_workers == 0 && _computed) _computed->close();
+}
 
-        for (std::vector<string_writer_pair>::const_iterator wi = _writers.begin(); wi != _writers.end(); ++wi)
+void ComputeDescriptors::_write_thread()
+{
+    ComputeStats::ThreadStats& stats = _stats.add_thread();
+
+    item_t item;
+    while (!_error && _computed->pop(item))
+    {
+        try
+        {
+            write(item.index, *item.data, stats);
+        }
+        catch (std::exception& e)
         {
-            anymap_t::const_iterator ri = data.find(wi->first);
-            if (ri != data.end()) wi->second->push_back(current, ri->second);
+            fail(e.what());
+            break;
         }
     }
 }
@@ -6,47 +6,119 @@
 #include <QDateTime>
 
 #include <util/types.hpp>
+#include <util/bounded_queue.hpp>
 #include <io/filelist.hpp>
 #include <io/property_writer.hpp>
 #include <descriptors/generator.hpp>
 
 #include "ordered_push_back.hpp"
+#include "compute_stats.hpp"
+#include "descriptor_cache.hpp"
 
 namespace imdb {
 
+/**
+ * Computes descriptors for all files of a FileList using several threads and stores the results
+ * in the writers added by add_writer().
+ *
+ * The work is split into three stages: decoding the image, computing the descriptors and handing
+ * the results to the writers. By default each compute thread runs all three stages itself. When
+ * decode and/or write threads are passed to start(), these stages run in their own threads instead
+ * and are connected to the compute threads by bounded queues, i.e. slow I/O (e.g. on a network
+ * filesystem) does not leave the compute threads idle while the queues bound the number of images
+ * held in memory.
+ *
+ * The time spent in each stage is recorded per thread, see metrics().
+ *
+ * With a DescriptorCache (see set_cache()), files found in the cache are neither decoded nor
+ * computed, their cached results are passed to the writers instead. Results computed for all
+ * other files are added to the cache.
+ */
 class ComputeDescriptors
 {
     typedef std::pair<std::string, boost::shared_ptr<OrderedPushBack> > string_writer_pair;
 
+    /// file index, the data computed for it so far and the time spent on it
+    struct item_t
+    {
+        item_t() : index(0), us(0), key(0), cached(false) {}
+
+        size_t                        index;
+        boost::shared_ptr<anymap_t>   data;
+        uint64_t                      us;
+
+        /// DescriptorCache key and whether data has been taken from the cache
+        uint64_t                      key;
+        bool                          cached;
+    };
+
     public:
 
     ComputeDescriptors(boost::shared_ptr<imdb::Generator> generator, const imdb::FileList& files);
 
-    void add_writer(const std::string& name, boost::shared_ptr<imdb::PropertyWriter> writer);
+    /// The computation starts at the first index that is missing in one of the writers, i.e. writers
+    /// opened with PropertyWriter::open_append() continue where they stopped. See OrderedPushBack for
+    /// max_buffered and mode, with max_buffered > 0 no file is started before the writer is able to take its result.
+    void add_writer(const std::string& name, boost::shared_ptr<imdb::PropertyWriter> writer, size_t checkpoint_interval = 0,
+                    size_t max_buffered = 0, WriteMode mode = WriteInOrder);
 
-    bool start(int num_threads);
+    /// Runs the computation using num_threads compute threads, num_decode_threads threads that decode the
+    /// images and num_write_threads threads that pass the results to the writers. 0 decode/write threads
+    /// means that the compute threads take care of the respective stage themselves.
+    bool start(int num_threads, int num_decode_threads = 0, int num_write_threads = 0);
 
     size_t current() const;
     bool finished() const;
 
+    /// Takes results from cache where possible and adds all others to it, must be called before start()
+    void set_cache(boost::shared_ptr<DescriptorCache> cache);
+
+    /// Number of slowest files reported by metrics(), must be called before start()
+    void set_num_slowest(size_t num_slowest);
+
+    const ComputeStats& stats() const;
+
+    /// Stores the progress, throughput, fill levels of the queues and the writers' reorder buffers,
+    /// the timing of each stage and the slowest files in pt. Can be called while start() is running.
+    void metrics(ptree& pt) const;
+
     index_t num_files() const;
+    const FileList& files() const;
     int computation_time() const;
 
     private:
 
+    bool next_index(size_t& index, ComputeStats::ThreadStats& stats);
+    void decode(item_t& item, ComputeStats::ThreadStats& stats) const;
+    void write(size_t index, anymap_t& data, ComputeStats::ThreadStats& stats);
+    void fail(const std::string& message);
+
+    void _decode_thread();
     void _thread(boost::shared_ptr<imdb::Generator> gen);
+    void _write_thread();
 
     boost::shared_ptr<imdb::Generator> _generator;
     std::vector<string_writer_pair>    _writers;
     imdb::FileList                     _files;
+    imdb::ImageRequirements            _requirements;
+    boost::shared_ptr<DescriptorCache> _cache;
 
     volatile size_t _index;
+    size_t          _first;
     volatile bool _error;
     volatile bool _started;
     volatile bool _finished;
 
+    boost::scoped_ptr<bounded_queue<item_t> > _decoded;
+    boost::scoped_ptr<bounded_queue<item_t> > _computed;
+    int _active_decoders;
+    int _active_workers;
+
     QDateTime _datetime;
     int       _seconds;
+    uint64_t  _start_us;
+
+    ComputeStats _stats;
 
     mutable boost::mutex _mutex;
 };
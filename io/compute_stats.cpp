@@ -0,0 +1,152 @@
+#include "compute_stats.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace imdb;
+
+namespace imdb {
+
+const char* stage_name(ComputeStage stage)
+{
+    static const char* names[NumComputeStages] = { "read", "decode", "compute", "wait", "write", "cache" };
+    return names[stage];
+}
+
+uint64_t now_us()
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+} // namespace imdb
+
+ComputeStats::ThreadStats::ThreadStats(size_t num_slowest)
+    : _numSlowest(num_slowest)
+    , _cacheHits(0)
+    , _cacheMisses(0)
+{}
+
+void ComputeStats::ThreadStats::add(ComputeStage stage, uint64_t us)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _stages[stage].add(us);
+}
+
+void ComputeStats::ThreadStats::add_file(size_t index, uint64_t us)
+{
+    if (_numSlowest == 0) return;
+
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (_slowest.size() < _numSlowest)
+    {
+        _slowest.push(file_time_t(us, index));
+    }
+    else if (_slowest.top().first < us)
+    {
+        _slowest.pop();
+        _slowest.push(file_time_t(us, index));
+    }
+}
+
+void ComputeStats::ThreadStats::add_cache_lookup(bool hit)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (hit) _cacheHits++;
+    else _cacheMisses++;
+}
+
+ComputeStats::ComputeStats(size_t num_slowest)
+    : _numSlowest(num_slowest)
+{}
+
+void ComputeStats::set_num_slowest(size_t num_slowest)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    assert(_threads.empty());
+    _numSlowest = num_slowest;
+}
+
+ComputeStats::ThreadStats& ComputeStats::add_thread()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _threads.push_back(shared_ptr<ThreadStats>(new ThreadStats(_numSlowest)));
+    return *_threads.back();
+}
+
+LatencyHistogram ComputeStats::stage(ComputeStage stage) const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    LatencyHistogram merged;
+    for (size_t i = 0; i < _threads.size(); i++)
+    {
+        boost::lock_guard<boost::mutex> thread_lock(_threads[i]->_mutex);
+        merged.merge(_threads[i]->_stages[stage]);
+    }
+    return merged;
+}
+
+uint64_t ComputeStats::cache_hits() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    uint64_t hits = 0;
+    for (size_t i = 0; i < _threads.size(); i++)
+    {
+        boost::lock_guard<boost::mutex> thread_lock(_threads[i]->_mutex);
+        hits += _threads[i]->_cacheHits;
+    }
+    return hits;
+}
+
+uint64_t ComputeStats::cache_misses() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    uint64_t misses = 0;
+    for (size_t i = 0; i < _threads.size(); i++)
+    {
+        boost::lock_guard<boost::mutex> thread_lock(_threads[i]->_mutex);
+        misses += _threads[i]->_cacheMisses;
+    }
+    return misses;
+}
+
+std::vector<ComputeStats::file_time_t> ComputeStats::slowest() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+
+    std::vector<file_time_t> files;
+    for (size_t i = 0; i < _threads.size(); i++)
+    {
+        boost::lock_guard<boost::mutex> thread_lock(_threads[i]->_mutex);
+
+        // copy the heap, we cannot iterate over a priority_queue
+        ThreadStats::slowest_t heap(_threads[i]->_slowest);
+        for (; !heap.empty(); heap.pop()) files.push_back(heap.top());
+    }
+
+    std::sort(files.begin(), files.end(), std::greater<file_time_t>());
+    if (files.size() > _numSlowest) files.resize(_numSlowest);
+    return files;
+}
+
+void ComputeStats::stages_to_ptree(ptree& pt) const
+{
+    for (int s = 0; s < NumComputeStages; s++)
+    {
+        LatencyHistogram h = stage(static_cast<ComputeStage>(s));
+
+        ptree& st = pt.put_child(stage_name(static_cast<ComputeStage>(s)), ptree());
+        st.put("count", h.count());
+        st.put("total_ms", h.sum() / 1000);
+        st.put("mean_us", static_cast<uint64_t>(h.mean()));
+        st.put("p50_us", h.quantile(0.5));
+        st.put("p90_us", h.quantile(0.9));
+        st.put("p99_us", h.quantile(0.99));
+        st.put("max_us", h.max());
+    }
+}
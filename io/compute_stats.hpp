@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef COMPUTE_STATS_HPP
+#define COMPUTE_STATS_HPP
+
+#include <queue>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <util/types.hpp>
+#include <util/latency_histogram.hpp>
+
+namespace imdb {
+
+/// The stages of ComputeDescriptors that are timed by ComputeStats
+enum ComputeStage
+{
+    StageRead,      ///< reading the file into memory
+    StageDecode,    ///< decoding the image
+    StageCompute,   ///< Generator::compute()
+    StageWait,      ///< waiting for room in the writers' reorder buffers, see OrderedPushBack
+    StageWrite,     ///< passing the results to the writers
+    StageCache,     ///< looking up and storing results in the DescriptorCache
+    NumComputeStages
+};
+
+/// Name of the stage as used in the metrics, e.g. "decode"
+const char* stage_name(ComputeStage stage);
+
+/// Current (wall clock) time in microseconds, used to time the stages
+uint64_t now_us();
+
+/**
+ * @ingroup IO
+ * @brief Per-stage timing of ComputeDescriptors and the files that took longest.
+ *
+ * Each thread records into its own ThreadStats (see add_thread()), i.e. the threads never
+ * wait for each other. The accessors merge the statistics of all threads and can be called
+ * at any time, e.g. by a thread that periodically reports the progress.
+ */
+class ComputeStats : boost::noncopyable
+{
+    public:
+
+    /// time in microseconds and file index
+    typedef std::pair<uint64_t, size_t> file_time_t;
+
+    class ThreadStats : boost::noncopyable
+    {
+        public:
+
+        void add(ComputeStage stage, uint64_t us);
+
+        /// Records the total time spent on file index, keeps only the slowest files
+        void add_file(size_t index, uint64_t us);
+
+        void add_cache_lookup(bool hit);
+
+        private:
+
+        friend class ComputeStats;
+
+        explicit ThreadStats(size_t num_slowest);
+
+        typedef std::priority_queue<file_time_t, std::vector<file_time_t>, std::greater<file_time_t> > slowest_t;
+
+        // only contended while the statistics are merged
+        mutable boost::mutex _mutex;
+        LatencyHistogram     _stages[NumComputeStages];
+        slowest_t            _slowest;
+        size_t               _numSlowest;
+        uint64_t             _cacheHits;
+        uint64_t             _cacheMisses;
+    };
+
+    /// Keeps track of the num_slowest slowest files
+    explicit ComputeStats(size_t num_slowest = 10);
+
+    /// Must be called before add_thread()
+    void set_num_slowest(size_t num_slowest);
+
+    /// Statistics for a new thread, valid for the lifetime of this object
+    ThreadStats& add_thread();
+
+    /// Timing of the given stage merged over all threads
+    LatencyHistogram stage(ComputeStage stage) const;
+
+    /// Number of DescriptorCache lookups that found an entry / did not find one
+    uint64_t cache_hits() const;
+    uint64_t cache_misses() const;
+
+    /// The slowest files of all threads sorted by decreasing time
+    std::vector<file_time_t> slowest() const;
+
+    /// Stores count, total time (ms), mean time and approximate percentiles (us) of each stage in pt
+    void stages_to_ptree(ptree& pt) const;
+
+    private:
+
+    mutable boost::mutex                    _mutex;
+    std::vector<shared_ptr<ThreadStats> >   _threads;
+    size_t                                  _numSlowest;
+};
+
+} // namespace imdb
+
+#endif // COMPUTE_STATS_HPP
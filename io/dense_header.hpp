@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef DENSE_HEADER_HPP
+#define DENSE_HEADER_HPP
+
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <cstring>
+
+#include "../util/types.hpp"
+#include "io.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup io
+ * @brief Header of a dense property file.
+ *
+ * Dense property files store fixed-dimension float vectors (global descriptors, vocabularies)
+ * as a single row-major matrix. The file consists of this header, padded to size() bytes,
+ * followed by rows*stride floats. Each row starts at a 64-byte boundary relative to the start
+ * of the file, i.e. a mapped or directly read file can be used for SIMD processing as-is.
+ *
+ * In contrast to the regular property files there is neither an offset table nor a per-element
+ * length prefix: the position of row i is simply size() + i*stride*sizeof(float).
+ */
+struct dense_header
+{
+    static const char* magic() { return "IMDBDNS1"; }
+
+    // if you change the internal format, be sure to also adapt DensePropertyWriter
+    // and read_property(FeatureMatrix&, const string&)
+    static int version() { return 1; }
+
+    /// Size of the header in bytes, this is also the offset of the first row
+    static std::size_t size() { return 64; }
+
+    dense_header() : rows(0), cols(0), stride(0) {}
+
+    int64_t rows;
+    int64_t cols;
+    int64_t stride;
+
+    void write(std::ostream& os) const
+    {
+        size_t t = 0;
+        os.write(magic(), 8); t += 8;
+        t += io::write(os, static_cast<int32_t>(version()));
+        t += io::write(os, static_cast<int32_t>(sizeof(float)));
+        t += io::write(os, rows);
+        t += io::write(os, cols);
+        t += io::write(os, stride);
+        for (; t < size(); t++) io::write(os, static_cast<int8_t>(0));
+    }
+
+    /// @throw std::runtime_error in case is does not contain a dense header of the current version
+    void read(std::istream& is)
+    {
+        char m[8];
+        is.read(m, 8);
+        if (!is.good() || std::memcmp(m, magic(), 8) != 0) throw std::runtime_error("not a dense property file");
+
+        int32_t v = 0, element_size = 0;
+        io::read(is, v);
+        io::read(is, element_size);
+        if (v != version()) throw std::runtime_error("version of dense property file is different from program version");
+        if (element_size != sizeof(float)) throw std::runtime_error("unsupported element type in dense property file");
+
+        io::read(is, rows);
+        io::read(is, cols);
+        io::read(is, stride);
+        if (!is.good()) throw std::runtime_error("error while reading dense property file header");
+
+        is.seekg(size());
+    }
+};
+
+
+/**
+ * @ingroup io
+ * @brief Checks whether filename is a dense property file (as opposed to a regular property file).
+ */
+inline bool is_dense_property_file(const std::string& filename)
+{
+    std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+    char m[8];
+    ifs.read(m, 8);
+    return ifs.good() && std::memcmp(m, dense_header::magic(), 8) == 0;
+}
+
+} // namespace imdb
+
+#endif // DENSE_HEADER_HPP
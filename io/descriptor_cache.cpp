@@ -0,0 +1,195 @@
+#include "descriptor_cache.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+
+#include <boost/filesystem.hpp>
+
+#include "io.hpp"
+#include "memory_stream.hpp"
+#include "../util/hash.hpp"
+
+using namespace imdb;
+
+namespace {
+
+// sorts all children by their key, such that equal parameters always serialize to the same string
+void sort_recursive(ptree& pt)
+{
+    pt.sort();
+    for (ptree::iterator it = pt.begin(); it != pt.end(); ++it) sort_recursive(it->second);
+}
+
+// size of the header of an entry: key and size of the data
+const int64_t entry_header_bytes = 2 * sizeof(uint64_t);
+
+} // namespace
+
+DescriptorCache::DescriptorCache(const std::string& directory, shared_ptr<Generator> generator, KeyMode mode)
+    : _mode(mode)
+    , _generator(generator)
+{
+    namespace fs = boost::filesystem;
+
+    // everything that influences the content of the entries goes into the name of the subdirectory
+    ptree params = generator->parameters();
+    sort_recursive(params);
+
+    std::ostringstream config;
+    config << "imdb descriptor cache 1" << std::endl;
+    boost::property_tree::write_json(config, params, false);
+
+    PropertyWriters::properties_t& properties = generator->propertyWriters().get();
+    for (PropertyWriters::properties_t::const_iterator it = properties.begin(); it != properties.end(); ++it)
+    {
+        config << it->first << " " << typeid(*it->second).name() << std::endl;
+    }
+
+    std::string c = config.str();
+    std::ostringstream name;
+    name << params.get<std::string>("generator.name", "generator") << "_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(c.data(), c.size());
+
+    _path = (fs::path(directory) / name.str()).string();
+    try
+    {
+        fs::create_directories(_path);
+    }
+    catch (const fs::filesystem_error& e)
+    {
+        throw std::runtime_error("DescriptorCache: cannot create directory " + _path + ": " + e.what());
+    }
+
+    // for humans looking into the cache directory
+    std::string paramsname = (fs::path(_path) / "parameters").string();
+    if (!fs::exists(paramsname)) boost::property_tree::write_json(paramsname, generator->parameters());
+
+    open_index();
+}
+
+void DescriptorCache::open_index()
+{
+    namespace fs = boost::filesystem;
+
+    std::string filename = (fs::path(_path) / "entries").string();
+    int64_t file_size = fs::exists(filename) ? static_cast<int64_t>(fs::file_size(filename)) : 0;
+
+    // collect key and offset of all complete entries
+    int64_t pos = 0;
+    {
+        std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+        while (ifs.is_open() && pos + entry_header_bytes <= file_size)
+        {
+            uint64_t key, size;
+            ifs.seekg(pos);
+            io::read(ifs, key);
+            io::read(ifs, size);
+            if (!ifs.good() || pos + entry_header_bytes + static_cast<int64_t>(size) > file_size) break;
+
+            _index.push_back(std::make_pair(key, pos));
+            pos += entry_header_bytes + size;
+        }
+    }
+
+    // remove a partly written entry, new entries are appended after the last complete one
+    if (pos < file_size) fs::resize_file(filename, pos);
+
+    std::sort(_index.begin(), _index.end());
+
+    _append.open(filename.c_str(), std::ofstream::binary | std::ofstream::app);
+    if (!_append.is_open()) throw std::runtime_error("DescriptorCache: cannot open file " + filename);
+
+    _entries.open(filename);
+}
+
+DescriptorCache::KeyMode DescriptorCache::mode() const
+{
+    return _mode;
+}
+
+uint64_t DescriptorCache::stat_key(const std::string& filename)
+{
+    namespace fs = boost::filesystem;
+
+    std::ostringstream os;
+    os << filename << std::endl << fs::file_size(filename) << std::endl << fs::last_write_time(filename);
+
+    std::string s = os.str();
+    return fnv1a(s.data(), s.size());
+}
+
+uint64_t DescriptorCache::content_key(const std::vector<uchar>& content)
+{
+    uint64_t size = content.size();
+    uint64_t h = fnv1a(reinterpret_cast<const char*>(&size), sizeof(size));
+    return content.empty() ? h : fnv1a(reinterpret_cast<const char*>(&content[0]), content.size(), h);
+}
+
+bool DescriptorCache::lookup(uint64_t key, anymap_t& data) const
+{
+    std::vector<std::pair<uint64_t, int64_t> >::const_iterator it;
+    it = std::lower_bound(_index.begin(), _index.end(), std::make_pair(key, static_cast<int64_t>(0)));
+    if (it == _index.end() || it->first != key) return false;
+
+    uint64_t header[2];
+    _entries.read(reinterpret_cast<char*>(header), sizeof(header), it->second);
+
+    std::vector<char> buffer(header[1]);
+    if (!buffer.empty()) _entries.read(&buffer[0], buffer.size(), it->second + entry_header_bytes);
+
+    imemstream is(buffer.empty() ? 0 : &buffer[0], buffer.size());
+
+    PropertyWriters::properties_t& properties = _generator->propertyWriters().get();
+    for (PropertyWriters::properties_t::const_iterator pi = properties.begin(); pi != properties.end(); ++pi)
+    {
+        uint8_t present;
+        io::read(is, present);
+        if (present) pi->second->deserialize(is, data[pi->first]);
+    }
+
+    if (!is.good()) throw std::runtime_error("DescriptorCache: corrupt entry in " + _path);
+    return true;
+}
+
+void DescriptorCache::insert(uint64_t key, const anymap_t& data)
+{
+    std::ostringstream os(std::ios::binary);
+
+    PropertyWriters::properties_t& properties = _generator->propertyWriters().get();
+    for (PropertyWriters::properties_t::const_iterator pi = properties.begin(); pi != properties.end(); ++pi)
+    {
+        anymap_t::const_iterator di = data.find(pi->first);
+        uint8_t present = (di != data.end());
+        io::write(os, present);
+        if (present) pi->second->serialize(os, di->second);
+    }
+
+    std::string entry = os.str();
+
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    io::write(_append, key);
+    io::write(_append, static_cast<uint64_t>(entry.size()));
+    _append.write(entry.data(), entry.size());
+    if (!_append.good()) throw std::runtime_error("DescriptorCache: writing to " + _path + " failed");
+}
+
+size_t DescriptorCache::size() const
+{
+    return _index.size();
+}
+
+const std::string& DescriptorCache::path() const
+{
+    return _path;
+}
+
+void DescriptorCache::close()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (!_append.is_open()) return;
+
+    _append.close();
+    if (_append.fail()) throw std::runtime_error("DescriptorCache: writing to " + _path + " failed");
+}
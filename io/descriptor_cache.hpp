@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef DESCRIPTOR_CACHE_HPP
+#define DESCRIPTOR_CACHE_HPP
+
+#include <fstream>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "../util/types.hpp"
+#include "../descriptors/generator.hpp"
+#include "positional_file.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup IO
+ * @brief On-disk cache of the results of a Generator, addressed by the content of the input file.
+ *
+ * Lets compute_descriptors skip decoding and computing all files that have not changed since
+ * an earlier run. The cache lives in a directory that can hold the results of several generators:
+ * each combination of generator, parameters and property types gets its own subdirectory named
+ * after a hash of these, i.e. changing a parameter never returns stale results.
+ *
+ * A file is identified by a 64-bit key, either computed from its name, size and modification
+ * time (stat_key(), no need to read the file) or from its content (content_key(), survives
+ * moving/renaming files). Each entry stores all properties of the generator as serialized by
+ * PropertyWriter::serialize(), entries are appended to a single file and an index of all entries
+ * is built when the cache is opened. Entries added by insert() are therefore only visible to
+ * lookup() after reopening the cache. An entry that has only partly been written (e.g. when the
+ * program crashed) is removed when the cache is opened.
+ *
+ * lookup() and insert() can be called from several threads at the same time.
+ */
+class DescriptorCache : boost::noncopyable
+{
+    public:
+
+    enum KeyMode
+    {
+        KeyStat,    ///< key from filename, size and modification time
+        KeyContent  ///< key from the file content
+    };
+
+    /// Opens the cache for generator in directory, creates it if necessary.
+    /// @throw std::runtime_error if the cache cannot be opened
+    DescriptorCache(const std::string& directory, shared_ptr<Generator> generator, KeyMode mode = KeyStat);
+
+    KeyMode mode() const;
+
+    /// Key from the name, size and modification time of the file
+    static uint64_t stat_key(const std::string& filename);
+
+    /// Key from the content of a file
+    static uint64_t content_key(const std::vector<uchar>& content);
+
+    /// Stores the cached properties under their names in data
+    /// @return false if there is no entry for key
+    bool lookup(uint64_t key, anymap_t& data) const;
+
+    /// Adds the properties of the generator contained in data under key
+    void insert(uint64_t key, const anymap_t& data);
+
+    /// Number of entries found when the cache was opened
+    size_t size() const;
+
+    /// Subdirectory holding the entries of this generator
+    const std::string& path() const;
+
+    /// Flushes all entries added by insert()
+    /// @throw std::runtime_error if writing failed
+    void close();
+
+    private:
+
+    void open_index();
+
+    KeyMode                             _mode;
+    shared_ptr<Generator>               _generator;
+    std::string                         _path;
+
+    /// key and offset of the entry, sorted by key
+    std::vector<std::pair<uint64_t, int64_t> > _index;
+    positional_file                     _entries;
+
+    mutable boost::mutex                _mutex;
+    std::ofstream                       _append;
+};
+
+} // namespace imdb
+
+#endif // DESCRIPTOR_CACHE_HPP
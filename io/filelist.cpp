@@ -135,5 +135,24 @@ void FileList::random_sample(size_t new_size, size_t seed)
     for (size_t i = 0; i < new_files.size(); i++) new_files[i] = _files[indices[i]];
     _files = new_files;
 }
+
+void FileList::select_shard(size_t shard, size_t num_shards, bool strided)
+{
+    if (shard >= num_shards) throw std::runtime_error("FileList: invalid shard index");
+
+    std::vector<std::string> new_files;
+    if (strided)
+    {
+        for (size_t i = shard; i < _files.size(); i += num_shards) new_files.push_back(_files[i]);
+    }
+    else
+    {
+        // shard sizes differ by at most one file
+        size_t first = shard * _files.size() / num_shards;
+        size_t last = (shard + 1) * _files.size() / num_shards;
+        new_files.assign(_files.begin() + first, _files.begin() + last);
+    }
+    _files.swap(new_files);
+}
 }
 
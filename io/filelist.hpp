@@ -59,6 +59,13 @@ class FileList
     /// Subsample given filelist randomly
     void random_sample(size_t new_size, size_t seed);
 
+    /// Keep only the files of shard 'shard' out of 'num_shards' shards, e.g. to distribute a
+    /// computation over several machines. The shards either are contiguous ranges of the list or,
+    /// if strided is set, contain every num_shards-th file starting at file 'shard'. Concatenating
+    /// (respectively interleaving) the shards in order gives the original list again.
+    /// @throw std::runtime_error if shard >= num_shards
+    void select_shard(size_t shard, size_t num_shards, bool strided = false);
+
     /// Returns the current root directory
     const string& root_dir() const;
 
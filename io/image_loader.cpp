@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "image_loader.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/highgui/highgui.hpp>
+
+// cv::IMREAD_REDUCED_* flags have been added in OpenCV 3.2
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+#define IMDB_IMREAD_REDUCED
+#endif
+
+namespace imdb {
+
+bool jpeg_image_size(const std::vector<uchar>& data, cv::Size& size)
+{
+    if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    // walk through the segments up to the first start of frame (SOFn) marker, each
+    // segment is 0xFF, marker, 2 bytes big endian length (including the length itself)
+    size_t pos = 2;
+    while (pos + 4 <= data.size())
+    {
+        if (data[pos] != 0xFF) return false;
+
+        uchar marker = data[pos + 1];
+
+        // fill bytes
+        if (marker == 0xFF)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+
+        // SOF0 - SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 9 > data.size()) return false;
+            size.height = (data[pos + 5] << 8) | data[pos + 6];
+            size.width  = (data[pos + 7] << 8) | data[pos + 8];
+            return size.width > 0 && size.height > 0;
+        }
+
+        // start of scan: entropy coded data follows, we have missed the frame header
+        if (marker == 0xDA) return false;
+
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
+void read_file(const std::string& filename, std::vector<uchar>& buffer)
+{
+    std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+    if (!ifs.is_open()) throw std::runtime_error("read_file: could not open file: " + filename);
+
+    ifs.seekg(0, std::ios::end);
+    buffer.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0, std::ios::beg);
+    if (!buffer.empty()) ifs.read(reinterpret_cast<char*>(&buffer[0]), buffer.size());
+    if (!ifs.good()) throw std::runtime_error("read_file: could not read file: " + filename);
+}
+
+bool decode_image(const std::vector<uchar>& buffer, const ImageRequirements& requirements, anymap_t& data)
+{
+    // flags: 0 decodes a grayscale image, 1 a 3-channel color image
+    int flags = requirements.grayscale ? 0 : 1;
+
+#ifdef IMDB_IMREAD_REDUCED
+    // libjpeg can decode at 1/2, 1/4 or 1/8 of the resolution directly from the DCT coefficients,
+    // choose the largest factor that still satisfies the requirements. Note that OpenCV implements
+    // the reduced modes for other formats by decoding at full resolution and resizing with linear
+    // interpolation, which causes aliasing, so we only use them for JPEG.
+    cv::Size size;
+    if (requirements.longer_side > 0 && jpeg_image_size(buffer, size))
+    {
+        int longer  = std::max(size.width, size.height);
+        int shorter = std::min(size.width, size.height);
+
+        int factor = 8;
+        while (factor > 1 && (longer / factor < requirements.longer_side || shorter / factor < requirements.shorter_side)) factor /= 2;
+
+        if (factor == 8)      flags = requirements.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        else if (factor == 4) flags = requirements.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        else if (factor == 2) flags = requirements.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    }
+#endif
+
+    // Although this is not explicitly stated in the OpenCV docs, the channel
+    // order of color images is BGR, see ComputeDescriptors
+    cv::Mat image = cv::imdecode(buffer, flags);
+    if (image.empty()) return false;
+
+    if (requirements.grayscale) data["image_gray"] = mat_8uc1_t(image);
+    else data["image"] = mat_8uc3_t(image);
+    return true;
+}
+
+void load_image(const std::string& filename, const ImageRequirements& requirements, anymap_t& data)
+{
+    // read the whole file at once, such that we can look at the header before decoding
+    std::vector<uchar> buffer;
+    read_file(filename, buffer);
+    if (!decode_image(buffer, requirements, data)) throw std::runtime_error("load_image: could not decode image: " + filename);
+}
+
+} // namespace imdb
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef IMAGE_LOADER_HPP
+#define IMAGE_LOADER_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include "../util/types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup IO
+ * @brief Describes the input image a Generator works on, see Generator::input_requirements().
+ *
+ * A generator that downscales every image anyway can let the loader decode the image at a
+ * reduced resolution, which for JPEG files is done in the DCT domain and is many times faster
+ * than decoding at full resolution. The loader guarantees that the longer side of the decoded
+ * image is at least longer_side and its shorter side at least shorter_side pixels (or the
+ * original size for smaller images), 0 means that the full resolution is required.
+ */
+struct ImageRequirements
+{
+    ImageRequirements(int longer_side_ = 0, int shorter_side_ = 0, bool grayscale_ = false)
+        : longer_side(longer_side_), shorter_side(shorter_side_), grayscale(grayscale_) {}
+
+    int  longer_side;
+    int  shorter_side;
+
+    /// the generator only needs a grayscale image
+    bool grayscale;
+};
+
+/**
+ * @ingroup IO
+ * @brief Reads width and height from the header of a JPEG file without decoding it.
+ * @return false if data does not start with a valid JPEG header
+ */
+bool jpeg_image_size(const std::vector<uchar>& data, cv::Size& size);
+
+/**
+ * @ingroup IO
+ * @brief Reads the whole file into buffer.
+ * @throw std::runtime_error if the file cannot be read
+ */
+void read_file(const std::string& filename, std::vector<uchar>& buffer);
+
+/**
+ * @ingroup IO
+ * @brief Decodes an image file that has been read into memory, see load_image().
+ * @return false if buffer does not contain a valid image
+ */
+bool decode_image(const std::vector<uchar>& buffer, const ImageRequirements& requirements, anymap_t& data);
+
+/**
+ * @ingroup IO
+ * @brief Loads an image at the lowest resolution that satisfies the requirements.
+ *
+ * Stores the image as "image_gray" (mat_8uc1_t) if requirements.grayscale is set, otherwise as "image"
+ * (mat_8uc3_t, BGR channel order). Reduced resolution decoding is only used for JPEG files and requires
+ * OpenCV >= 3.2, all other images are decoded at full resolution.
+ *
+ * @throw std::runtime_error if the file cannot be read or decoded
+ */
+void load_image(const std::string& filename, const ImageRequirements& requirements, anymap_t& data);
+
+} // namespace imdb
+
+#endif // IMAGE_LOADER_HPP
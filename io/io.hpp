@@ -18,6 +18,10 @@ the terms of the BSD license (see the LICENSE file).
 #include <boost/cstdint.hpp>
 #include <boost/array.hpp>
 #include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+
+#include "../util/reduced_precision.hpp"
+#include "../util/ragged_matrix.hpp"
 
 namespace imdb {
 
@@ -31,6 +35,27 @@ namespace imdb {
  */
 namespace io
 {
+    /// True for types whose in-memory representation is also their serialized representation, a
+    /// vector<T> of such types is read/written with a single read/write call.
+    ///
+    /// Besides arithmetic types this holds for pairs and boost::arrays of such types as long as they
+    /// contain no padding, e.g. the pair<uint32_t, float> postings of the InvertedIndex.
+    template <class T>
+    struct is_raw_serializable : boost::is_arithmetic<T> {};
+
+    template <>
+    struct is_raw_serializable<float16_t> : boost::true_type {};
+
+    template <class T1, class T2>
+    struct is_raw_serializable<std::pair<T1, T2> >
+        : boost::integral_constant<bool, is_raw_serializable<T1>::value && is_raw_serializable<T2>::value
+                                         && sizeof(std::pair<T1, T2>) == sizeof(T1) + sizeof(T2)> {};
+
+    template <class T, std::size_t N>
+    struct is_raw_serializable<boost::array<T, N> >
+        : boost::integral_constant<bool, is_raw_serializable<T>::value && sizeof(boost::array<T, N>) == N * sizeof(T)> {};
+
+
     // ----------------------------------------------------------------------------
     // Signatures -- we need them to allow arbitrary nestings in the following
     // implementation part. Otherwise the implementation for e.g. std::pair<T1,T2>
@@ -74,6 +99,14 @@ namespace io
     template <class T>
     size_t read(std::istream& is, std::set<T>& v);
 
+    size_t write(std::ostream& os, const vec_q8_t& v);
+
+    size_t read(std::istream& is, vec_q8_t& v);
+
+    size_t write(std::ostream& os, const RaggedMatrix& v);
+
+    size_t read(std::istream& is, RaggedMatrix& v);
+
 
     // ----------------------------------------------------------------------------
     // Implementations
@@ -106,11 +139,13 @@ namespace io
    inline size_t write(std::ostream& os, uint64_t v) { return _write(os, v); }
    inline size_t write(std::ostream& os, float v)    { return _write(os, v); }
    inline size_t write(std::ostream& os, double v)   { return _write(os, v); }
+   inline size_t write(std::ostream& os, float16_t v) { return _write(os, v.bits); }
    inline size_t write(std::ostream& os, const std::string& v)
     {
         size_t t = 0;
         t += write(os, static_cast<int32_t>(v.length()));
-        for (size_t i = 0; i < v.length(); i++) t += write(os, reinterpret_cast<const int8_t&>(v[i]));
+        os.write(v.data(), v.length());
+        t += v.length();
         return t;
     }
 
@@ -124,13 +159,15 @@ namespace io
     inline size_t read(std::istream& is, uint64_t& v) { return _read(is, v); }
     inline size_t read(std::istream& is, float& v)    { return _read(is, v); }
     inline size_t read(std::istream& is, double& v)   { return _read(is, v); }
+    inline size_t read(std::istream& is, float16_t& v) { return _read(is, v.bits); }
     inline size_t read(std::istream& is, std::string& v)
     {
         int32_t s;
         size_t t = 0;
         t += read(is, s);
         v.resize(s);
-        for (size_t i = 0; i < v.length(); i++) t += read(is, reinterpret_cast<int8_t&>(v[i]));
+        if (s > 0) is.read(&v[0], s);
+        t += v.length();
         return t;
     }
 
@@ -165,12 +202,13 @@ namespace io
         // Arithmetic types are all floating points and integral types, see
         // http://www.boost.org/doc/libs/1_48_0/libs/type_traits/doc/html/boost_typetraits/reference/is_arithmetic.html
         //
-        // In case the vector contains arithmetic types we use a more
-        // efficient implementation and write its whole content at once.
-        if (boost::is_arithmetic<T>::value)
+        // In case the vector contains arithmetic types (or other raw serializable
+        // types such as float16_t) we use a more efficient implementation and
+        // write its whole content at once.
+        if (is_raw_serializable<T>::value)
         {
             size_t num_bytes = v.size()*sizeof(T);
-            os.write(reinterpret_cast<const char*>(&v[0]), num_bytes);
+            if (num_bytes > 0) os.write(reinterpret_cast<const char*>(&v[0]), num_bytes);
             t+=num_bytes;
         }
 
@@ -195,10 +233,10 @@ namespace io
         // Specialized function to read in a complete vector<float/double/int>
         // etc. with a single read. This gives us about 4x performance over
         // calling read for all entries separately (the more general case).
-        if (boost::is_arithmetic<T>::value)
+        if (is_raw_serializable<T>::value)
         {
             size_t num_bytes = size*sizeof(T);
-            is.read(reinterpret_cast<char*>(&v[0]), num_bytes);
+            if (num_bytes > 0) is.read(reinterpret_cast<char*>(&v[0]), num_bytes);
             t+=num_bytes;
         }
         else
@@ -283,6 +321,56 @@ namespace io
         }
         return s;
     }
+
+
+    inline size_t write(std::ostream& os, const vec_q8_t& v)
+    {
+        size_t s = 0;
+        s += write(os, v.scale);
+        s += write(os, v.data);
+        return s;
+    }
+
+    inline size_t read(std::istream& is, vec_q8_t& v)
+    {
+        size_t s = 0;
+        s += read(is, v.scale);
+        s += read(is, v.data);
+        return s;
+    }
+
+
+    // RaggedMatrix uses the same layout as a vec_vec_f32_t, i.e. the number of rows
+    // followed by (size, values) for each row
+    inline size_t write(std::ostream& os, const RaggedMatrix& v)
+    {
+        size_t s = write(os, static_cast<int64_t>(v.size()));
+        for (size_t i = 0; i < v.size(); i++)
+        {
+            size_t n = v.row_size(i);
+            s += write(os, static_cast<int64_t>(n));
+            if (n > 0) os.write(reinterpret_cast<const char*>(v[i].begin()), n*sizeof(float));
+            s += n*sizeof(float);
+        }
+        return s;
+    }
+
+    inline size_t read(std::istream& is, RaggedMatrix& v)
+    {
+        v.clear();
+
+        int64_t rows = 0;
+        size_t s = read(is, rows);
+        for (int64_t i = 0; i < rows; i++)
+        {
+            int64_t n = 0;
+            s += read(is, n);
+            RaggedMatrix::row r = v.append(n);
+            if (n > 0) is.read(reinterpret_cast<char*>(r.begin()), n*sizeof(float));
+            s += n*sizeof(float);
+        }
+        return s;
+    }
 }
 
 } // namespace imdb
@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef MEMORY_STREAM_HPP
+#define MEMORY_STREAM_HPP
+
+#include <istream>
+#include <streambuf>
+#include <cstddef>
+
+namespace imdb {
+
+/**
+ * @ingroup io
+ * @brief Read-only std::streambuf operating directly on an existing memory range.
+ *
+ * The range is not copied, it must stay valid for the lifetime of the buffer. We use
+ * this to run the regular imdb::io::read() functions on memory-mapped files and on
+ * buffers that have been filled by a single large read.
+ */
+class memory_streambuf : public std::streambuf
+{
+    public:
+
+    memory_streambuf(const char* begin, const char* end)
+    {
+        char* b = const_cast<char*>(begin);
+        char* e = const_cast<char*>(end);
+        setg(b, b, e);
+    }
+
+    protected:
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in)
+    {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+        char* p = 0;
+        if (dir == std::ios_base::beg)      p = eback() + off;
+        else if (dir == std::ios_base::cur) p = gptr() + off;
+        else                                p = egptr() + off;
+
+        if (p < eback() || p > egptr()) return pos_type(off_type(-1));
+
+        setg(eback(), p, egptr());
+        return pos_type(p - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in)
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+
+/**
+ * @ingroup io
+ * @brief std::istream reading from a memory range, see memory_streambuf.
+ */
+class imemstream : private memory_streambuf, public std::istream
+{
+    public:
+
+    imemstream(const char* begin, const char* end)
+        : memory_streambuf(begin, end)
+        , std::istream(static_cast<memory_streambuf*>(this))
+    {}
+
+    imemstream(const char* begin, std::size_t size)
+        : memory_streambuf(begin, begin + size)
+        , std::istream(static_cast<memory_streambuf*>(this))
+    {}
+};
+
+} // namespace imdb
+
+#endif // MEMORY_STREAM_HPP
@@ -2,34 +2,117 @@
 
 using namespace imdb;
 
-OrderedPushBack::OrderedPushBack(shared_ptr<PropertyWriter> writer)
+OrderedPushBack::OrderedPushBack(shared_ptr<PropertyWriter> writer, size_t checkpoint_interval, size_t max_buffered, WriteMode mode)
     : _writer(writer)
-    , _numWrittenElements(0)
-{}
+    , _numWrittenElements(writer->size())
+    , _checkpointInterval(checkpoint_interval)
+    , _nextCheckpoint(0)
+    , _maxBuffered(max_buffered)
+    , _mode(mode)
+    , _cancelled(false)
+{
+    if (_checkpointInterval > 0) _nextCheckpoint = (_numWrittenElements / _checkpointInterval + 1) * _checkpointInterval;
+}
 
-bool OrderedPushBack::push_back(size_t index, const boost::any& element)
+bool OrderedPushBack::push_back(size_t index, boost::any& element)
 {
-    boost::lock_guard<boost::mutex> locked(_mutex);
+    boost::unique_lock<boost::mutex> locked(_mutex);
 
-    // since the things we have written so far is just a linear
-    // index of features, this condition must hold, i.e. all elements
-    // we get must be at the end or behind of what has been written so far
-    assert(index >= _numWrittenElements);
+    // when resuming, other writers may be behind this one and the
+    // element might already be in the file
+    if (index < _numWrittenElements) return true;
+
+    if (_mode == WriteOutOfOrder)
+    {
+        bool okay = _writer->insert(element, index);
+        element = boost::any();
+        written(index);
+        return okay;
+    }
 
-    _queue.push(queue_element(index, make_shared<boost::any>(element)));
+    while (!_cancelled && !writable(index)) _progress.wait(locked);
+    if (_cancelled) return false;
+
+    // only the (empty) holder is allocated, the content of element is swapped into it
+    shared_ptr<boost::any> e(new boost::any());
+    e->swap(element);
+    _queue.push(queue_element(index, e));
 
     // *linearly* write stuff into the output vector
     while (!_queue.empty() && _queue.top().first == _numWrittenElements)
     {
         _writer->push_back(*_queue.top().second);
         _queue.pop();
-        _numWrittenElements++;
+        written(_numWrittenElements);
     }
 
     return true;
 }
 
+bool OrderedPushBack::wait_writable(size_t index) const
+{
+    boost::unique_lock<boost::mutex> locked(_mutex);
+    while (!_cancelled && !writable(index)) _progress.wait(locked);
+    return !_cancelled;
+}
+
+void OrderedPushBack::cancel()
+{
+    boost::lock_guard<boost::mutex> locked(_mutex);
+    _cancelled = true;
+    _progress.notify_all();
+}
+
+size_t OrderedPushBack::num_written() const
+{
+    boost::lock_guard<boost::mutex> locked(_mutex);
+    return _numWrittenElements;
+}
+
+void OrderedPushBack::close()
+{
+    boost::lock_guard<boost::mutex> locked(_mutex);
+    _writer->close();
+}
+
+size_t OrderedPushBack::num_buffered() const
+{
+    boost::lock_guard<boost::mutex> locked(_mutex);
+    return _queue.size() + _writtenAhead.size();
+}
+
 bool OrderedPushBack::empty_buffer() const
 {
-    return _queue.empty();
+    boost::lock_guard<boost::mutex> locked(_mutex);
+    return _queue.empty() && _writtenAhead.empty();
+}
+
+bool OrderedPushBack::writable(size_t index) const
+{
+    return _mode == WriteOutOfOrder || _maxBuffered == 0 || index < _numWrittenElements + _maxBuffered;
+}
+
+// bookkeeping after element index has been passed to the writer, requires _mutex to be locked
+void OrderedPushBack::written(size_t index)
+{
+    if (index != _numWrittenElements)
+    {
+        _writtenAhead.insert(index);
+        return;
+    }
+
+    _numWrittenElements++;
+    while (!_writtenAhead.empty() && *_writtenAhead.begin() == _numWrittenElements)
+    {
+        _writtenAhead.erase(_writtenAhead.begin());
+        _numWrittenElements++;
+    }
+    _progress.notify_all();
+
+    // a checkpoint must not contain gaps, with WriteOutOfOrder it is delayed until all gaps are closed
+    if (_checkpointInterval > 0 && _numWrittenElements >= _nextCheckpoint && _writtenAhead.empty())
+    {
+        _writer->checkpoint();
+        _nextCheckpoint = (_numWrittenElements / _checkpointInterval + 1) * _checkpointInterval;
+    }
 }
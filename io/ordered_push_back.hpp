@@ -2,6 +2,7 @@
 #define ORDERED_PUSH_BACK_HPP
 
 #include <queue>
+#include <set>
 
 #include <boost/thread.hpp>
 
@@ -10,27 +11,81 @@
 
 namespace imdb {
 
+/// How OrderedPushBack passes elements that arrive out of order to its writer
+enum WriteMode
+{
+    WriteInOrder,   ///< elements are buffered until all preceding elements have arrived, then appended with PropertyWriter::push_back()
+    WriteOutOfOrder ///< elements are written immediately using PropertyWriter::insert(), nothing is buffered
+};
+
+/**
+ * Writes elements that are computed by several threads, i.e. that arrive in arbitrary order,
+ * into a PropertyWriter such that element i ends up at index i.
+ *
+ * With WriteInOrder, at most max_buffered elements are held back (0 means unbounded). A push_back()
+ * of an element that is max_buffered or more elements ahead of the next one to be written blocks
+ * until the gap has been closed. Use wait_writable() before starting to compute an element to make
+ * sure the thread holding the next element is never blocked.
+ *
+ * With WriteOutOfOrder, elements are written into the file as they arrive and the writer's offset
+ * table takes care of the order. This does not work with sharded writers, and checkpoints are only
+ * made at times when there are no gaps in the written elements.
+ */
 class OrderedPushBack
 {
     public:
 
-    OrderedPushBack(shared_ptr<PropertyWriter> writer);
+    /// Elements already contained in the writer (e.g. after PropertyWriter::open_append()) are skipped,
+    /// every checkpoint_interval elements PropertyWriter::checkpoint() is called (0 disables checkpoints). push_back()
+    /// calls of other threads wait while a checkpoint flushes the writer.
+    OrderedPushBack(shared_ptr<PropertyWriter> writer, size_t checkpoint_interval = 0, size_t max_buffered = 0, WriteMode mode = WriteInOrder);
+
+    /// Takes over element without copying its content, element is empty afterwards.
+    /// Returns false if cancel() has been called.
+    bool push_back(size_t index, boost::any& element);
+
+    /// Blocks until push_back(index, ...) would not block, returns false if cancel() has been called
+    bool wait_writable(size_t index) const;
+
+    /// Wakes up all threads blocked in push_back() or wait_writable(), these return false from now on
+    void cancel();
 
-    bool push_back(size_t index, const boost::any& element);
+    /// Number of elements in the writer, not counting elements written out of order after a gap
+    size_t num_written() const;
 
+    /// Number of elements waiting for a missing element (WriteInOrder) or written after a gap (WriteOutOfOrder)
+    size_t num_buffered() const;
+
+    /// True if no element is waiting for (or, with WriteOutOfOrder, written after) a missing element
     bool empty_buffer() const;
 
+    /// Closes the underlying writer, throws in case the writer reports an error
+    void close();
+
     private:
 
+    bool writable(size_t index) const;
+    void written(size_t index);
+
     boost::shared_ptr<PropertyWriter> _writer;
     std::size_t _numWrittenElements;
-    boost::mutex _mutex;
+    std::size_t _checkpointInterval;
+    std::size_t _nextCheckpoint;
+    std::size_t _maxBuffered;
+    WriteMode   _mode;
+    bool        _cancelled;
+
+    mutable boost::mutex _mutex;
+    mutable boost::condition_variable _progress;
 
     typedef std::pair<size_t, boost::shared_ptr<boost::any> > queue_element;
     typedef std::greater<queue_element>                       queue_compare;
     typedef std::priority_queue<queue_element, std::vector<queue_element>, queue_compare> queue_t;
 
     queue_t _queue;
+
+    /// WriteOutOfOrder only: indices written after the first gap
+    std::set<size_t> _writtenAhead;
 };
 
 } // namespace imdb
@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef POSITIONAL_FILE_HPP
+#define POSITIONAL_FILE_HPP
+
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/utility.hpp>
+
+#include "../util/types.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+namespace imdb {
+
+/**
+ * @ingroup io
+ * @brief Read-only file supporting reads at explicit positions.
+ *
+ * In contrast to std::ifstream, read() does not depend on (or change) a file position,
+ * i.e. a single instance can be used from several threads at the same time. Uses pread()
+ * on POSIX systems and overlapped ReadFile() on Windows.
+ */
+class positional_file : boost::noncopyable
+{
+    public:
+
+    positional_file() : _size(0)
+    {
+#ifdef _WIN32
+        _handle = INVALID_HANDLE_VALUE;
+#else
+        _fd = -1;
+#endif
+    }
+
+    ~positional_file()
+    {
+        close();
+    }
+
+    /// @throw std::runtime_error in case the file cannot be opened
+    void open(const std::string& filename)
+    {
+        close();
+
+#ifdef _WIN32
+        _handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        if (_handle == INVALID_HANDLE_VALUE) throw std::runtime_error("could not open file " + filename);
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(_handle, &size);
+        _size = size.QuadPart;
+#else
+        _fd = ::open(filename.c_str(), O_RDONLY);
+        if (_fd < 0) throw std::runtime_error("could not open file " + filename);
+
+        struct stat st;
+        if (fstat(_fd, &st) != 0) throw std::runtime_error("could not stat file " + filename);
+        _size = st.st_size;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (_handle != INVALID_HANDLE_VALUE) CloseHandle(_handle);
+        _handle = INVALID_HANDLE_VALUE;
+#else
+        if (_fd >= 0) ::close(_fd);
+        _fd = -1;
+#endif
+        _size = 0;
+    }
+
+    bool is_open() const
+    {
+#ifdef _WIN32
+        return _handle != INVALID_HANDLE_VALUE;
+#else
+        return _fd >= 0;
+#endif
+    }
+
+    /// Size of the file in bytes
+    int64_t size() const { return _size; }
+
+    /// Reads exactly n bytes starting at position offset into buffer.
+    /// @throw std::runtime_error in case of an error or if the file is too short
+    void read(char* buffer, std::size_t n, int64_t offset) const
+    {
+        while (n > 0)
+        {
+#ifdef _WIN32
+            OVERLAPPED ov = OVERLAPPED();
+            ov.Offset     = static_cast<DWORD>(offset);
+            ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(n, 1 << 30));
+            DWORD r = 0;
+            if (!ReadFile(_handle, buffer, chunk, &r, &ov) || r == 0) throw std::runtime_error("positional_file: read failed");
+#else
+            ssize_t r = ::pread(_fd, buffer, n, offset);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) throw std::runtime_error("positional_file: read failed");
+#endif
+            buffer += r;
+            offset += r;
+            n      -= r;
+        }
+    }
+
+    private:
+
+#ifdef _WIN32
+    HANDLE  _handle;
+#else
+    int     _fd;
+#endif
+    int64_t _size;
+};
+
+} // namespace imdb
+
+#endif // POSITIONAL_FILE_HPP
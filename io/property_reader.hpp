@@ -12,12 +12,29 @@ the terms of the BSD license (see the LICENSE file).
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <limits>
 
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/static_assert.hpp>
 #include <boost/utility.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #include "../util/types.hpp"
+#include "../util/feature_matrix.hpp"
+#include "../util/bounded_queue.hpp"
 #include "io.hpp"
+#include "dense_header.hpp"
+#include "shard_manifest.hpp"
+#include "memory_stream.hpp"
+#include "positional_file.hpp"
+#include "block_codec.hpp"
 #include "type_names.hpp"
 
 
@@ -29,6 +46,67 @@ namespace imdb {
  */
 
 
+/**
+ * @brief Selects how PropertyReaderT accesses the underlying file.
+ */
+enum PropertyAccessMode
+{
+    /// Each get() seeks in a std::ifstream and deserializes the element (default).
+    PropertyAccessStream,
+
+    /// The file is memory-mapped. get() deserializes straight from the mapping, view() gives
+    /// zero-copy access to elements with arithmetic element type.
+    PropertyAccessMapped,
+
+    /// Each get() reads the element with a single positional read (pread) that does not
+    /// depend on a shared file position, i.e. get() can be called from several threads concurrently.
+    PropertyAccessPositional
+};
+
+
+/**
+ * @brief Describes the zero-copy view PropertyReaderT::view() hands out for elements of type T.
+ *
+ * Only elements whose serialized representation is a plain array of values can be viewed in
+ * place: raw serializable T itself (a view of size 1) and std::vector<E> with raw serializable E
+ * (an int64_t length prefix followed by the raw array), see io::is_raw_serializable.
+ */
+template <class T>
+struct property_view
+{
+    static const bool supported = io::is_raw_serializable<T>::value;
+
+    typedef T                                         value_type;
+    typedef boost::iterator_range<const value_type*> type;
+
+    static type make(const char* p)
+    {
+        const value_type* data = reinterpret_cast<const value_type*>(p);
+        return type(data, data + 1);
+    }
+};
+
+template <class E, class A>
+struct property_view<std::vector<E, A> >
+{
+    static const bool supported = io::is_raw_serializable<E>::value;
+
+    typedef E                                         value_type;
+    typedef boost::iterator_range<const value_type*> type;
+
+    static type make(const char* p)
+    {
+        int64_t size;
+        std::memcpy(&size, p, sizeof(size));
+        const value_type* data = reinterpret_cast<const value_type*>(p + sizeof(size));
+        return type(data, data + size);
+    }
+};
+
+
+template <class T> class PropertyCursorT;
+
+
 /**
  * @brief Class for reading a property file generated by PropertyWriterT.
  *
@@ -38,6 +116,19 @@ namespace imdb {
  *
  * You are responsible for matching T to the type you used when writing the file. No internal checks
  * are made to avoid mismatches: in that case reading either fails or you will read garbage.
+ *
+ * With PropertyAccessMapped, the file is memory-mapped instead of being read through a std::ifstream.
+ * This is usually much faster for files that are already held in the page cache, and for element types
+ * supported by property_view, view() returns a non-owning range pointing directly into the mapping, i.e.
+ * no element is ever copied. Note that views are only valid as long as the reader exists.
+ *
+ * get() is safe to be called concurrently from several threads with PropertyAccessMapped and
+ * PropertyAccessPositional, but not with PropertyAccessStream, which shares a single std::ifstream.
+ *
+ * Block-compressed files (version 3, see PropertyWriterT::set_codec()) are read transparently in all
+ * access modes. get() decompresses the block containing the element, the most recently used block is
+ * cached such that sequential access decompresses each block only once. view() is not available for
+ * such files.
  */
 template <class T>
 class PropertyReaderT : public boost::noncopyable
@@ -51,23 +142,392 @@ public:
         return 2;
     }
 
+    // version of the block-compressed format
+    static int block_version()
+    {
+        return 3;
+    }
+
 
     /// Construct a reader operating on filename.
     /// @throw std::runtime_error in case the file cannot be openend, the file is corrupt or the version does not match
-    PropertyReaderT(const std::string& filename)
-        : _ifs(filename.c_str(), std::ifstream::binary)
+    PropertyReaderT(const std::string& filename, PropertyAccessMode mode = PropertyAccessStream)
+        : _mode(mode)
         , _offset(new std::vector<int64_t>())
         , _map(new strmap_t())
+        , _cached_index(-1)
+    {
+        if (_mode == PropertyAccessMapped)
+        {
+            try { _mapped.open(filename); }
+            catch (const std::exception&) { throw std::runtime_error("could not map file " + filename); }
+
+            imemstream is(_mapped.data(), _mapped.size());
+            read_header(is, filename);
+        }
+        else if (_mode == PropertyAccessPositional)
+        {
+            _file.open(filename);
+
+            std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+            if (!ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+            read_header(ifs, filename);
+        }
+        else
+        {
+            _ifs.open(filename.c_str(), std::ifstream::binary);
+            if (!_ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+            read_header(_ifs, filename);
+        }
+    }
+
+    /// Random access into the file, reading the element at position index
+    void get(T& r, index_t index) const
     {
-        if (!_ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+        if (_codec)
+        {
+            int64_t vo = (*_offset)[index];
+            shared_ptr<const std::vector<char> > block = load_block(vo >> 32);
+
+            const char* data = block->empty() ? 0 : &(*block)[0];
+            imemstream is(data + (vo & 0xffffffff), data + block->size());
+            io::read(is, r);
+            assert(!is.fail());
+            return;
+        }
+
+        int64_t p = _p_features + (*_offset)[index];
+
+        if (_mode == PropertyAccessMapped)
+        {
+            imemstream is(_mapped.data() + p, _mapped.data() + _p_offsets);
+            io::read(is, r);
+            assert(is.good());
+        }
+        else if (_mode == PropertyAccessPositional)
+        {
+            std::vector<char> buffer(_p_features + _end[index] - p);
+            if (!buffer.empty()) _file.read(&buffer[0], buffer.size(), p);
+
+            imemstream is(buffer.empty() ? 0 : &buffer[0], buffer.size());
+            io::read(is, r);
+            assert(!is.fail());
+        }
+        else
+        {
+            if (p != _ifs.tellg()) _ifs.seekg(p);
+            io::read(_ifs, r);
+            assert(_ifs.good());
+        }
+    }
+
+    /**
+     * @brief Reads the elements [first, last) into the array starting at r.
+     *
+     * With PropertyAccessMapped and PropertyAccessPositional, elements that are stored one after the other
+     * (which is always the case for files written with push_back() only) are fetched with a single
+     * read and decoded from memory. Like get(), this is thread-safe except for PropertyAccessStream.
+     */
+    void get_range(T* r, index_t first, index_t last) const
+    {
+        if (first >= last) return;
+
+        if (_mode == PropertyAccessStream || _codec || !is_sequential(first, last))
+        {
+            for (index_t i = first; i < last; i++) get(r[i - first], i);
+            return;
+        }
+
+        int64_t begin = _p_features + (*_offset)[first];
+        int64_t end   = _p_features + _end[last - 1];
+
+        std::vector<char> buffer;
+        const char* data = 0;
+        if (_mode == PropertyAccessMapped)
+        {
+            data = _mapped.data() + begin;
+        }
+        else
+        {
+            buffer.resize(end - begin);
+            if (!buffer.empty()) _file.read(&buffer[0], buffer.size(), begin);
+            data = buffer.empty() ? 0 : &buffer[0];
+        }
+
+        imemstream is(data, end - begin);
+        for (index_t i = first; i < last; i++) io::read(is, r[i - first]);
+        assert(!is.fail());
+    }
+
+    /// Callback of get_many(): position of the request in the indices passed to get_many() and the element,
+    /// which the callback may swap out
+    typedef boost::function<void (std::size_t, T&)> get_many_fn;
+
+    /// Gap between two requested elements up to which get_many() reads (and skips) the bytes in
+    /// between rather than issuing a separate read
+    static int64_t get_many_gap()
+    {
+        return 64 << 10;
+    }
+
+    /// Maximum number of bytes get_many() fetches with a single read
+    static int64_t get_many_run_bytes()
+    {
+        return 16 << 20;
+    }
+
+    /**
+     * @brief Reads the elements at the given indices, calling callback(k, element) for the k-th index.
+     *
+     * The requests are sorted by their position in the file and neighbouring elements are merged into runs
+     * that are fetched with a single read each (see get_many_gap() and get_many_run_bytes()), i.e. a large
+     * random sample of a file is read at disk bandwidth instead of paying a seek per element. The callback
+     * is therefore called in the order of the file, k tells the position of the request in indices.
+     *
+     * With PropertyAccessMapped and PropertyAccessPositional, the runs are read and decoded by num_threads
+     * threads (0 uses one thread per core), the callback then must be thread-safe. With PropertyAccessStream
+     * and for block-compressed files, the elements are read one after the other in the order of the file.
+     * @throw std::runtime_error in case reading fails
+     */
+    void get_many(const std::vector<index_t>& indices, const get_many_fn& callback, std::size_t num_threads = 1) const
+    {
+        const std::vector<int64_t>& offset = *_offset;
+
+        // requests sorted by position in the file
+        std::vector<std::pair<int64_t, std::size_t> > requests(indices.size());
+        for (std::size_t k = 0; k < indices.size(); k++) requests[k] = std::make_pair(offset[indices[k]], k);
+        std::sort(requests.begin(), requests.end());
+
+        if (_mode == PropertyAccessStream || _codec)
+        {
+            // a single forward pass, for block-compressed files this decompresses each block only once
+            T r;
+            for (std::size_t i = 0; i < requests.size(); i++)
+            {
+                get(r, indices[requests[i].second]);
+                callback(requests[i].second, r);
+            }
+            return;
+        }
+
+        // merge the requests into runs, runs[j] is the first request of run j
+        std::vector<std::size_t> runs;
+        int64_t run_begin = 0;
+        int64_t run_end   = 0;
+        for (std::size_t i = 0; i < requests.size(); i++)
+        {
+            int64_t b = requests[i].first;
+            int64_t e = _end[indices[requests[i].second]];
+            if (i == 0 || b - run_end > get_many_gap() || e - run_begin > get_many_run_bytes())
+            {
+                runs.push_back(i);
+                run_begin = b;
+                run_end   = e;
+            }
+            else run_end = std::max(run_end, e);
+        }
+        runs.push_back(requests.size());
+
+        if (num_threads == 0) num_threads = std::max(1u, boost::thread::hardware_concurrency());
+        num_threads = std::min(num_threads, runs.size() - 1);
+
+        std::size_t next = 0;
+        boost::mutex mutex;
+        std::string error;
+
+        if (num_threads <= 1)
+        {
+            get_many_runs(indices, requests, runs, callback, next, mutex, error);
+        }
+        else
+        {
+            boost::thread_group pool;
+            for (std::size_t i = 0; i < num_threads; i++)
+            {
+                pool.create_thread(boost::bind(&PropertyReaderT::get_many_runs, this, boost::cref(indices), boost::cref(requests), boost::cref(runs),
+                                               boost::cref(callback), boost::ref(next), boost::ref(mutex), boost::ref(error)));
+            }
+            pool.join_all();
+        }
+
+        if (!error.empty()) throw std::runtime_error("PropertyReaderT: get_many failed: " + error);
+    }
+
+    /// Reads the elements at the given indices into r, i.e. r[k] is the element at indices[k], see get_many() above
+    void get_many(const std::vector<index_t>& indices, std::vector<T>& r, std::size_t num_threads = 1) const
+    {
+        r.resize(indices.size());
+        get_many(indices, boost::bind(&PropertyReaderT::store_element, boost::ref(r), _1, _2), num_threads);
+    }
+
+    /// Zero-copy access to the element at position index, requires PropertyAccessMapped
+    /// and an element type supported by property_view.
+    typename property_view<T>::type view(index_t index) const
+    {
+        BOOST_STATIC_ASSERT(property_view<T>::supported);
+        assert(_mode == PropertyAccessMapped);
+        if (_codec) throw std::runtime_error("PropertyReaderT: view() is not supported for block-compressed property files");
+        return property_view<T>::make(_mapped.data() + _p_features + (*_offset)[index]);
+    }
+
+
+    /**
+     * @brief Lightweight collection adaptor presenting all elements of a mapped reader as views.
+     *
+     * Has size() and operator[] and can therefore be passed to e.g. linear_search() in place of
+     * a fully deserialized std::vector<T>.
+     */
+    class views_t
+    {
+        public:
+
+        typedef typename property_view<T>::type value_type;
+
+        views_t(const PropertyReaderT& reader) : _reader(&reader) {}
+
+        /// std::size_t like the std::vector<T> this replaces
+        std::size_t size() const { return static_cast<std::size_t>(_reader->size()); }
+        value_type operator[] (std::size_t index) const { return _reader->view(static_cast<index_t>(index)); }
+
+        private:
+
+        const PropertyReaderT* _reader;
+    };
+
+    views_t views() const
+    {
+        return views_t(*this);
+    }
 
-        _ifs.seekg(-static_cast<int>(sizeof(int64_t)), std::ios::end);
+
+    PropertyAccessMode mode() const
+    {
+        return _mode;
+    }
+
+    /// True if the file has been written in the block-compressed format
+    bool compressed() const
+    {
+        return _codec.get() != 0;
+    }
+
+    /// Number of bytes the element at position index occupies in the file, not available with PropertyAccessStream
+    int64_t byte_size(index_t index) const
+    {
+        assert(_mode != PropertyAccessStream);
+        return _end[index] - (*_offset)[index];
+    }
+
+    /// Convenience array-style random access, returning the element at position index
+    T operator[] (index_t index) const
+    {
+        T r;
+        get(r, index);
+        return r;
+    }
+
+
+    // iterators
+    class const_iterator : public boost::iterator_facade<const_iterator, T const, std::random_access_iterator_tag>
+    {
+    public:
+
+        const_iterator() : _reader(0), _index(0), _isvalid(false) {}
+
+    private:
+
+        const_iterator(const PropertyReaderT& reader, index_t index, shared_ptr<PropertyCursorT<T> > cursor = shared_ptr<PropertyCursorT<T> >())
+            : _reader(&reader)
+            , _index(index)
+            , _isvalid(false)
+            , _cursor(cursor)
+        {}
+
+        friend class boost::iterator_core_access;
+        friend class PropertyReaderT;
+
+        void increment() { _index++; _isvalid = false; }
+        void decrement() { _index--; _isvalid = false; }
+        void advance(index_t n) { _index += n; _isvalid = false; }
+
+        index_t distance_to(const const_iterator& other) const
+        {
+            return other._index - _index;
+        }
+
+        bool equal(const const_iterator& other) const
+        {
+            return (_reader == other._reader && _index == other._index);
+        }
+
+        const T& dereference() const
+        {
+            assert(_reader != 0);
+
+            if (!_isvalid)
+            {
+                // take the element from the read-ahead cursor as long as we are iterating
+                // sequentially, fall back to random access otherwise
+                if (_cursor && _cursor->index() == _index) _cursor->next(_current);
+                else _reader->get(_current, _index);
+                _isvalid = true;
+            }
+
+            return _current;
+        }
+
+        const PropertyReaderT* _reader;
+        index_t                _index;
+        mutable T              _current;
+        mutable bool           _isvalid;
+
+        shared_ptr<PropertyCursorT<T> > _cursor;
+    };
+
+    const_iterator begin() { return const_iterator(*this, 0); }
+    const_iterator end() { return const_iterator(*this, this->size()); }
+
+    /// Iterator that is fed by a PropertyCursorT, i.e. elements are read ahead in a background thread.
+    /// Use this for sequential passes over the file, requires PropertyAccessMapped or PropertyAccessPositional.
+    const_iterator begin_readahead() const
+    {
+        return const_iterator(*this, 0, shared_ptr<PropertyCursorT<T> >(new PropertyCursorT<T>(*this)));
+    }
+
+    // Note: the results needs to be an index_t as this
+    // is fixed to be a 64 bit int independent of the system architecture
+    index_t size() const
+    {
+        return _offset->size();
+    }
+
+    const strmap_t& map() const
+    {
+        return *_map;
+    }
+
+private:
+
+    // parses the map and offsets stored at the end of the file, is either
+    // is _ifs or a stream on top of the mapped memory region
+    void read_header(std::istream& is, const std::string& filename)
+    {
+        // dense files have no trailing map, give a helpful message instead of failing on garbage
+        char magic[8];
+        is.read(magic, 8);
+        if (is.good() && std::memcmp(magic, dense_header::magic(), 8) == 0)
+        {
+            throw std::runtime_error("file " + filename + " is a dense property file, use read_property(FeatureMatrix&, filename) to read it");
+        }
+        is.clear();
+
+        is.seekg(-static_cast<int>(sizeof(int64_t)), std::ios::end);
         int64_t p_map;
-        io::read(_ifs, p_map);
+        io::read(is, p_map);
 
-        _ifs.seekg(p_map);
-        if (!_ifs.good()) throw std::runtime_error("error while reading file " + filename);
-        io::read(_ifs, *_map);
+        is.seekg(p_map);
+        if (!is.good()) throw std::runtime_error("error while reading file " + filename);
+        io::read(is, *_map);
 
 
 
@@ -78,7 +538,7 @@ public:
 
         int p_version  = boost::lexical_cast<int>((*_map)["__version"]);
         bool ignore_type_info = false;
-        if (p_version != version())
+        if (p_version != version() && p_version != block_version())
         {
 
             // backwards compatibility with version 1 which did not yet have the __typeinfo data
@@ -124,24 +584,431 @@ public:
             }
         }
 
-        _ifs.seekg(p_offsets);
-        if (!_ifs.good()) throw std::runtime_error("error while reading file " + filename);
-        io::read(_ifs, *_offset);
+        is.seekg(p_offsets);
+        if (!is.good()) throw std::runtime_error("error while reading file " + filename);
+        io::read(is, *_offset);
 
-        if (!_ifs.good()) throw std::runtime_error("error while reading file " + filename);
+        if (!is.good()) throw std::runtime_error("error while reading file " + filename);
+
+        if (p_version == block_version())
+        {
+            if (!_map->count("__codec") || !_map->count("__blocks"))
+            {
+                throw std::runtime_error("error while reading map in file " + filename + "; block-compressed file without codec.");
+            }
+
+            _codec = BlockCodec::create((*_map)["__codec"]);
+
+            is.seekg(boost::lexical_cast<int64_t>((*_map)["__blocks"]));
+            io::read(is, _block_pos);
+            io::read(is, _block_size);
+            if (!is.good() || _block_pos.size() != _block_size.size()) throw std::runtime_error("error while reading block table in file " + filename);
+        }
 
         _p_features = p_features;
+        _p_offsets  = p_offsets;
+
+        if (_mode != PropertyAccessStream) compute_ends();
     }
 
-    /// Random access into the file, reading the element at position index
+    // computes for each element the position where its serialized data ends, i.e. the start of
+    // the element that follows it in the file (offsets are not necessarily sorted when the file
+    // has been written using insert())
+    void compute_ends()
+    {
+        const std::vector<int64_t>& offset = *_offset;
+
+        std::vector<std::pair<int64_t, index_t> > sorted;
+        sorted.reserve(offset.size());
+        for (std::size_t i = 0; i < offset.size(); i++)
+        {
+            if (offset[i] >= 0) sorted.push_back(std::make_pair(offset[i], static_cast<index_t>(i)));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        _end.assign(offset.size(), 0);
+        for (std::size_t k = 0; k < sorted.size(); k++)
+        {
+            if (_codec)
+            {
+                // virtual offsets, the last element of each block ends with the block
+                int64_t block = sorted[k].first >> 32;
+                bool same_block = k + 1 < sorted.size() && (sorted[k + 1].first >> 32) == block;
+                _end[sorted[k].second] = same_block ? sorted[k + 1].first : ((block << 32) | _block_size[block]);
+            }
+            else
+            {
+                _end[sorted[k].second] = (k + 1 < sorted.size()) ? sorted[k + 1].first : _p_offsets - _p_features;
+            }
+        }
+    }
+
+    // returns the decompressed block with index b, the last block is cached
+    shared_ptr<const std::vector<char> > load_block(int64_t b) const
+    {
+        {
+            boost::lock_guard<boost::mutex> locker(_cache_mutex);
+            if (_cached_block && _cached_index == b) return _cached_block;
+        }
+
+        int64_t p = _block_pos[b];
+        int64_t n;
+        read_bytes(reinterpret_cast<char*>(&n), sizeof(n), p);
+
+        shared_ptr<std::vector<char> > block = make_shared<std::vector<char> >(_block_size[b]);
+        char* dst = block->empty() ? 0 : &(*block)[0];
+
+        if (_mode == PropertyAccessMapped)
+        {
+            _codec->decode(_mapped.data() + p + sizeof(n), n, dst, block->size());
+        }
+        else
+        {
+            std::vector<char> encoded(n);
+            if (n > 0) read_bytes(&encoded[0], n, p + sizeof(n));
+            _codec->decode(encoded.empty() ? 0 : &encoded[0], n, dst, block->size());
+        }
+
+        boost::lock_guard<boost::mutex> locker(_cache_mutex);
+        _cached_block = block;
+        _cached_index = b;
+        return block;
+    }
+
+    // reads n bytes at position p, independent of the access mode
+    void read_bytes(char* dst, std::size_t n, int64_t p) const
+    {
+        if (_mode == PropertyAccessMapped)
+        {
+            std::memcpy(dst, _mapped.data() + p, n);
+        }
+        else if (_mode == PropertyAccessPositional)
+        {
+            _file.read(dst, n, p);
+        }
+        else
+        {
+            _ifs.seekg(p);
+            _ifs.read(dst, n);
+            if (!_ifs.good()) throw std::runtime_error("PropertyReaderT: error while reading block");
+        }
+    }
+
+    // worker of get_many(), repeatedly grabs the next run, reads it and decodes its elements
+    void get_many_runs(const std::vector<index_t>& indices, const std::vector<std::pair<int64_t, std::size_t> >& requests,
+                       const std::vector<std::size_t>& runs, const get_many_fn& callback,
+                       std::size_t& next, boost::mutex& mutex, std::string& error) const
+    {
+        std::vector<char> buffer;
+        T r;
+
+        for (;;)
+        {
+            std::size_t j;
+
+            {
+                boost::lock_guard<boost::mutex> locker(mutex);
+                if (next + 1 >= runs.size() || !error.empty()) break;
+                j = next++;
+            }
+
+            try
+            {
+                int64_t begin = requests[runs[j]].first;
+                int64_t end   = begin;
+                for (std::size_t i = runs[j]; i < runs[j + 1]; i++) end = std::max(end, _end[indices[requests[i].second]]);
+
+                const char* data = 0;
+                if (_mode == PropertyAccessMapped)
+                {
+                    data = _mapped.data() + _p_features + begin;
+                }
+                else
+                {
+                    buffer.resize(end - begin);
+                    if (!buffer.empty()) _file.read(&buffer[0], buffer.size(), _p_features + begin);
+                    data = buffer.empty() ? 0 : &buffer[0];
+                }
+
+                for (std::size_t i = runs[j]; i < runs[j + 1]; i++)
+                {
+                    imemstream is(data + (requests[i].first - begin), data + (end - begin));
+                    io::read(is, r);
+                    if (is.fail()) throw std::runtime_error("error while decoding element");
+                    callback(requests[i].second, r);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                boost::lock_guard<boost::mutex> locker(mutex);
+                error = e.what();
+                break;
+            }
+        }
+    }
+
+    static void store_element(std::vector<T>& r, std::size_t k, T& e)
+    {
+        using std::swap;
+        swap(r[k], e);
+    }
+
+    // true if the elements [first, last) are stored one after the other in the file
+    bool is_sequential(index_t first, index_t last) const
+    {
+        const std::vector<int64_t>& offset = *_offset;
+        if (offset[first] < 0) return false;
+        for (index_t i = first + 1; i < last; i++)
+        {
+            if (offset[i] != _end[i - 1]) return false;
+        }
+        return true;
+    }
+
+
+    PropertyAccessMode                       _mode;
+    mutable std::ifstream                    _ifs;
+    boost::iostreams::mapped_file_source     _mapped;
+    positional_file                          _file;
+    std::vector<int64_t>                     _end;
+    boost::shared_ptr<std::vector<int64_t> > _offset;
+    boost::shared_ptr<strmap_t>              _map;
+    int64_t                                  _p_features;
+    int64_t                                  _p_offsets;
+
+    // only used for block-compressed files
+    shared_ptr<BlockCodec>                   _codec;
+    std::vector<int64_t>                     _block_pos;
+    std::vector<int64_t>                     _block_size;
+    mutable boost::mutex                     _cache_mutex;
+    mutable shared_ptr<const std::vector<char> > _cached_block;
+    mutable int64_t                          _cached_index;
+};
+
+
+/**
+ * @brief Sequential read-ahead access to a range of elements of a PropertyReaderT.
+ *
+ * A background thread reads the elements in large blocks (each block with a single read, see
+ * PropertyReaderT::get_range()), decodes them and hands them over through a bounded queue,
+ * i.e. while the caller processes one block the next one is already being read. This makes
+ * sequential passes over a file run at disk bandwidth instead of paying a seek and a read per element.
+ *
+ * The reader must use PropertyAccessMapped or PropertyAccessPositional and must outlive the cursor.
+ *
+ * @code
+ * PropertyReaderT<vec_vec_f32_t> reader(filename, PropertyAccessPositional);
+ * PropertyCursorT<vec_vec_f32_t> cursor(reader);
+ * vec_vec_f32_t e;
+ * while (cursor.next(e)) { ... }
+ * @endcode
+ */
+template <class T>
+class PropertyCursorT : boost::noncopyable
+{
+    typedef std::vector<T>         block_t;
+    typedef shared_ptr<block_t>    block_ptr;
+
+public:
+
+    /**
+     * @param reader reader to read from
+     * @param first index of the first element to be returned
+     * @param last one past the index of the last element to be returned, clamped to reader.size()
+     * @param block_bytes approximate number of bytes fetched by a single read
+     * @param num_blocks number of decoded blocks that are held in memory ahead of the caller
+     * @throw std::runtime_error if the reader uses PropertyAccessStream
+     */
+    PropertyCursorT(const PropertyReaderT<T>& reader, index_t first = 0, index_t last = std::numeric_limits<index_t>::max(),
+                    int64_t block_bytes = 16 << 20, std::size_t num_blocks = 2)
+        : _reader(reader)
+        , _first(first)
+        , _last(std::min(last, reader.size()))
+        , _block_bytes(block_bytes)
+        , _queue(num_blocks)
+        , _index(first)
+        , _pos(0)
+    {
+        if (reader.mode() == PropertyAccessStream) throw std::runtime_error("PropertyCursorT: reader must not use PropertyAccessStream");
+        _thread = boost::thread(boost::bind(&PropertyCursorT::read_blocks, this));
+    }
+
+    ~PropertyCursorT()
+    {
+        // makes read_blocks() stop at its next push
+        _queue.close();
+        _thread.join();
+    }
+
+    /// Stores the next element in r, returns false when all elements have been returned.
+    /// @throw std::runtime_error in case reading in the background thread failed
+    bool next(T& r)
+    {
+        if (!_block || _pos == _block->size())
+        {
+            _block.reset();
+            _pos = 0;
+            if (!_queue.pop(_block))
+            {
+                if (!_error.empty()) throw std::runtime_error(_error);
+                return false;
+            }
+        }
+
+        using std::swap;
+        swap(r, (*_block)[_pos++]);
+        _index++;
+        return true;
+    }
+
+    /// Index of the element that will be returned by the next call to next()
+    index_t index() const
+    {
+        return _index;
+    }
+
+private:
+
+    void read_blocks()
+    {
+        try
+        {
+            index_t first = _first;
+            while (first < _last)
+            {
+                // collect elements until the block is large enough
+                index_t last = first;
+                int64_t bytes = 0;
+                while (last < _last && (last == first || bytes < _block_bytes))
+                {
+                    bytes += _reader.byte_size(last);
+                    last++;
+                }
+
+                block_ptr block = make_shared<block_t>(last - first);
+                _reader.get_range(&(*block)[0], first, last);
+                if (!_queue.push(block)) return;
+
+                first = last;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            // _error is only read by the consumer after pop() returned false, i.e. after close()
+            _error = e.what();
+        }
+
+        _queue.close();
+    }
+
+    const PropertyReaderT<T>& _reader;
+    index_t                   _first;
+    index_t                   _last;
+    int64_t                   _block_bytes;
+
+    bounded_queue<block_ptr>  _queue;
+    boost::thread             _thread;
+    std::string               _error;
+
+    // consumer side
+    block_ptr                 _block;
+    index_t                   _index;
+    std::size_t               _pos;
+};
+
+
+/**
+ * @brief Class for reading a sharded property file, i.e. a manifest together with its shards (see shard_manifest).
+ *
+ * Presents all shards as a single index space and offers the same get()/size()/iterator interface as
+ * PropertyReaderT. Each shard is opened by its own PropertyReaderT using the passed access mode. With
+ * PropertyAccessMapped and PropertyAccessPositional, get() is thread-safe; shard() gives access to the
+ * individual readers, e.g. to process the shards in parallel (possibly on different disks).
+ */
+template <class T>
+class ShardedPropertyReaderT : public boost::noncopyable
+{
+public:
+
+    typedef PropertyReaderT<T> reader_t;
+
+    /// Construct a reader operating on the manifest filename.
+    /// @throw std::runtime_error in case the manifest or one of the shards cannot be openend, or the type does not match
+    ShardedPropertyReaderT(const std::string& filename, PropertyAccessMode mode = PropertyAccessStream)
+        : _mode(mode)
+    {
+        shard_manifest manifest;
+        manifest.read(filename);
+
+        if (manifest.type_name != nameof<T>())
+        {
+            throw std::runtime_error("error: elements stored in property file " + filename + " are of type " + manifest.type_name + ". You are trying to read elements of type " + nameof<T>());
+        }
+
+        for (std::size_t i = 0; i < manifest.shards.size(); i++)
+        {
+            string shard = shard_manifest::resolve(filename, manifest.shards[i].filename);
+            _readers.push_back(shared_ptr<reader_t>(new reader_t(shard, mode)));
+            _first.push_back(manifest.shards[i].first);
+
+            if (_readers.back()->size() != manifest.shards[i].size)
+            {
+                throw std::runtime_error("shard " + shard + " does not match the manifest " + filename);
+            }
+        }
+
+        _size = manifest.size();
+    }
+
+    /// Random access into the shards, reading the element at position index
     void get(T& r, index_t index) const
     {
-        int64_t p = _p_features + (*_offset)[index];
-        if (p != _ifs.tellg()) _ifs.seekg(p);
-        io::read(_ifs, r);
-        assert(_ifs.good());
+        std::size_t s = shard_of(index);
+        _readers[s]->get(r, index - _first[s]);
+    }
+
+    /// Reads the elements [first, last) into the array starting at r, see PropertyReaderT::get_range()
+    void get_range(T* r, index_t first, index_t last) const
+    {
+        while (first < last)
+        {
+            std::size_t s = shard_of(first);
+            index_t end = std::min(last, _first[s] + _readers[s]->size());
+            _readers[s]->get_range(r, first - _first[s], end - _first[s]);
+
+            r += end - first;
+            first = end;
+        }
+    }
+
+    typedef typename reader_t::get_many_fn get_many_fn;
+
+    /// Reads the elements at the given indices, see PropertyReaderT::get_many(), the shards are processed one after the other
+    void get_many(const std::vector<index_t>& indices, const get_many_fn& callback, std::size_t num_threads = 1) const
+    {
+        // split the requests by shard, remembering their positions in indices
+        std::vector<std::vector<index_t> >     local(_readers.size());
+        std::vector<std::vector<std::size_t> > position(_readers.size());
+        for (std::size_t k = 0; k < indices.size(); k++)
+        {
+            std::size_t s = shard_of(indices[k]);
+            local[s].push_back(indices[k] - _first[s]);
+            position[s].push_back(k);
+        }
+
+        for (std::size_t s = 0; s < _readers.size(); s++)
+        {
+            if (local[s].empty()) continue;
+            _readers[s]->get_many(local[s], boost::bind(&ShardedPropertyReaderT::forward, boost::cref(position[s]), boost::cref(callback), _1, _2), num_threads);
+        }
     }
 
+    /// Reads the elements at the given indices into r, i.e. r[k] is the element at indices[k]
+    void get_many(const std::vector<index_t>& indices, std::vector<T>& r, std::size_t num_threads = 1) const
+    {
+        r.resize(indices.size());
+        get_many(indices, boost::bind(&ShardedPropertyReaderT::store_element, boost::ref(r), _1, _2), num_threads);
+    }
 
     /// Convenience array-style random access, returning the element at position index
     T operator[] (index_t index) const
@@ -151,6 +1018,32 @@ public:
         return r;
     }
 
+    PropertyAccessMode mode() const
+    {
+        return _mode;
+    }
+
+    index_t size() const
+    {
+        return _size;
+    }
+
+    std::size_t num_shards() const
+    {
+        return _readers.size();
+    }
+
+    /// Reader of shard i, its element 0 is element shard_first(i) of the sharded file
+    const reader_t& shard(std::size_t i) const
+    {
+        return *_readers[i];
+    }
+
+    index_t shard_first(std::size_t i) const
+    {
+        return _first[i];
+    }
+
 
     // iterators
     class const_iterator : public boost::iterator_facade<const_iterator, T const, std::random_access_iterator_tag>
@@ -161,14 +1054,14 @@ public:
 
     private:
 
-        const_iterator(const PropertyReaderT& reader, index_t index)
+        const_iterator(const ShardedPropertyReaderT& reader, index_t index)
             : _reader(&reader)
             , _index(index)
             , _isvalid(false)
         {}
 
         friend class boost::iterator_core_access;
-        friend class PropertyReaderT;
+        friend class ShardedPropertyReaderT;
 
         void increment() { _index++; _isvalid = false; }
         void decrement() { _index--; _isvalid = false; }
@@ -197,33 +1090,40 @@ public:
             return _current;
         }
 
-        const PropertyReaderT* _reader;
-        index_t                _index;
-        mutable T              _current;
-        mutable bool           _isvalid;
+        const ShardedPropertyReaderT* _reader;
+        index_t                       _index;
+        mutable T                     _current;
+        mutable bool                  _isvalid;
     };
 
-    const_iterator begin() { return const_iterator(*this, 0); }
-    const_iterator end() { return const_iterator(*this, this->size()); }
+    const_iterator begin() const { return const_iterator(*this, 0); }
+    const_iterator end() const { return const_iterator(*this, this->size()); }
 
-    // Note: the results needs to be an index_t as this
-    // is fixed to be a 64 bit int independent of the system architecture
-    index_t size() const
+private:
+
+    // index of the shard containing the element index
+    std::size_t shard_of(index_t index) const
     {
-        return _offset->size();
+        assert(index < _size);
+        return std::upper_bound(_first.begin(), _first.end(), index) - _first.begin() - 1;
     }
 
-    const strmap_t& map() const
+    // translates the position of a request inside a shard into its position in the indices passed to get_many()
+    static void forward(const std::vector<std::size_t>& position, const get_many_fn& callback, std::size_t k, T& e)
     {
-        return *_map;
+        callback(position[k], e);
     }
 
-private:
+    static void store_element(std::vector<T>& r, std::size_t k, T& e)
+    {
+        using std::swap;
+        swap(r[k], e);
+    }
 
-    mutable std::ifstream                    _ifs;
-    boost::shared_ptr<std::vector<int64_t> > _offset;
-    boost::shared_ptr<strmap_t>              _map;
-    int64_t                                  _p_features;
+    PropertyAccessMode               _mode;
+    std::vector<shared_ptr<reader_t> > _readers;
+    std::vector<index_t>             _first;
+    index_t                          _size;
 };
 
 
@@ -234,9 +1134,188 @@ private:
 template <class T>
 void read_property(std::vector<T>& v, const std::string& filename)
 {
-    PropertyReaderT<T> rd(filename);
+    if (is_sharded_property_file(filename))
+    {
+        ShardedPropertyReaderT<T> rd(filename);
+        v.resize(rd.size());
+        for (index_t i = 0; i < rd.size(); i++) rd.get(v[i], i);
+        return;
+    }
+
+    // read in large sequential chunks, for raw serializable element types (see io::is_raw_serializable)
+    // decoding then is a plain copy
+    PropertyReaderT<T> rd(filename, PropertyAccessPositional);
+    v.resize(rd.size());
+
+    index_t first = 0;
+    while (first < rd.size())
+    {
+        index_t last = first;
+        int64_t bytes = 0;
+        while (last < rd.size() && (last == first || bytes < (16 << 20))) bytes += rd.byte_size(last++);
+
+        rd.get_range(&v[first], first, last);
+        first = last;
+    }
+}
+
+
+// worker of the parallel read_property(), repeatedly grabs the next chunk of
+// elements and reads it, errors are reported back through error
+template <class reader_t, class T>
+void read_property_chunks(const reader_t& rd, std::vector<T>& v, index_t chunk, index_t& next, boost::mutex& mutex, std::string& error)
+{
+    for (;;)
+    {
+        index_t first;
+
+        {
+            boost::lock_guard<boost::mutex> locker(mutex);
+            if (next >= rd.size() || !error.empty()) break;
+            first = next;
+            next = std::min(next + chunk, rd.size());
+        }
+
+        index_t last = std::min(first + chunk, rd.size());
+
+        try { rd.get_range(&v[first], first, last); }
+        catch (const std::exception& e)
+        {
+            boost::lock_guard<boost::mutex> locker(mutex);
+            error = e.what();
+            break;
+        }
+    }
+}
+
+
+// implementation of the parallel read_property() for PropertyReaderT and ShardedPropertyReaderT
+template <class reader_t, class T>
+void read_property_parallel(const reader_t& rd, std::vector<T>& v, const std::string& filename, std::size_t num_threads)
+{
     v.resize(rd.size());
-    for (index_t i = 0; i < rd.size(); i++) rd.get(v[i], i);
+
+    // use several chunks per thread such that the load stays balanced even if the
+    // size of the elements varies a lot
+    index_t chunk = std::max<index_t>(1, rd.size() / (num_threads * 16));
+    index_t next = 0;
+    boost::mutex mutex;
+    std::string error;
+
+    boost::thread_group pool;
+    for (std::size_t i = 0; i < num_threads; i++)
+    {
+        pool.create_thread(boost::bind(&read_property_chunks<reader_t, T>, boost::cref(rd), boost::ref(v), chunk, boost::ref(next), boost::ref(mutex), boost::ref(error)));
+    }
+    pool.join_all();
+
+    if (!error.empty()) throw std::runtime_error("error while reading file " + filename + ": " + error);
+}
+
+
+/**
+ * @brief Parallel version of read_property(), reading the file using num_threads threads.
+ *
+ * The offset table is split into chunks of consecutive elements, each chunk is fetched with a
+ * single positional read (see PropertyAccessPositional) and decoded by one of the threads.
+ * Use this for large files, e.g. local features, where decoding a single-threaded read is CPU bound.
+ * Sharded property files are supported as well.
+ * @param num_threads number of threads, 0 uses one thread per core
+ */
+template <class T>
+void read_property(std::vector<T>& v, const std::string& filename, std::size_t num_threads)
+{
+    if (num_threads == 0) num_threads = std::max(1u, boost::thread::hardware_concurrency());
+
+    if (is_sharded_property_file(filename))
+    {
+        // the threads work on chunks of the combined index space, get_range() splits chunks spanning two shards
+        ShardedPropertyReaderT<T> rd(filename, PropertyAccessPositional);
+        read_property_parallel(rd, v, filename, num_threads);
+    }
+    else
+    {
+        PropertyReaderT<T> rd(filename, PropertyAccessPositional);
+        read_property_parallel(rd, v, filename, num_threads);
+    }
+}
+
+
+/**
+ * @brief Returns the name of the element type stored in a property file (see nameof()), without having to know it in advance.
+ *
+ * Dense property files always store vec_f32_t, for sharded property files the type is taken from the manifest. Files of the old version 1 have no type information, in that case
+ * an empty string is returned.
+ * @throw std::runtime_error in case the file cannot be opened or read
+ */
+inline std::string property_type_name(const std::string& filename)
+{
+    if (is_dense_property_file(filename)) return nameof<vec_f32_t>();
+
+    if (is_sharded_property_file(filename))
+    {
+        shard_manifest manifest;
+        manifest.read(filename);
+        return manifest.type_name;
+    }
+
+    std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+    if (!ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+    ifs.seekg(-static_cast<int>(sizeof(int64_t)), std::ios::end);
+    int64_t p_map;
+    io::read(ifs, p_map);
+
+    ifs.seekg(p_map);
+    strmap_t map;
+    io::read(ifs, map);
+    if (!ifs.good()) throw std::runtime_error("error while reading file " + filename);
+
+    return map.count("__typeinfo") ? map["__typeinfo"] : std::string();
+}
+
+
+/**
+ * @brief Reads a complete file of vec_f32_t elements into a FeatureMatrix.
+ *
+ * Dense property files (see DensePropertyWriter) are read with a single read straight into the
+ * matrix. Regular property files written with PropertyWriterT<vec_f32_t> are supported as well,
+ * in that case all elements must have the same size.
+ */
+inline void read_property(FeatureMatrix& m, const std::string& filename)
+{
+    m.clear();
+
+    if (is_dense_property_file(filename))
+    {
+        std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+        if (!ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        dense_header header;
+        header.read(ifs);
+        if (header.stride != static_cast<int64_t>(FeatureMatrix::aligned_stride(header.cols)))
+        {
+            throw std::runtime_error("unsupported row stride in dense property file " + filename);
+        }
+
+        m.resize(header.rows, header.cols);
+        if (!m.empty()) ifs.read(reinterpret_cast<char*>(m.data()), m.rows() * m.stride() * sizeof(float));
+        if (!ifs.good()) throw std::runtime_error("error while reading file " + filename);
+    }
+    else
+    {
+        PropertyReaderT<vec_f32_t> rd(filename, PropertyAccessMapped);
+        if (rd.compressed())
+        {
+            vec_f32_t e;
+            for (index_t i = 0; i < rd.size(); i++) { rd.get(e, i); m.push_back(e); }
+        }
+        else
+        {
+            if (rd.size() > 0) m.reserve(rd.size(), rd.view(0).size());
+            for (index_t i = 0; i < rd.size(); i++) m.push_back(rd.view(i));
+        }
+    }
 }
 
 
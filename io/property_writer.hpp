@@ -9,8 +9,21 @@ the terms of the BSD license (see the LICENSE file).
 #ifndef PROPERTY_WRITER_HPP
 #define PROPERTY_WRITER_HPP
 
+#include <sstream>
+#include <iostream>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/filesystem.hpp>
+
 #include "../util/types.hpp"
+#include "../util/feature_matrix.hpp"
+#include "../util/bounded_queue.hpp"
+#include "../util/hash.hpp"
 #include "io.hpp"
+#include "block_codec.hpp"
+#include "dense_header.hpp"
+#include "shard_manifest.hpp"
 #include "type_names.hpp"
 
 
@@ -34,6 +47,50 @@ struct PropertyWriter
     virtual void open(const string& filename) = 0;
     virtual bool push_back(const boost::any&) = 0;
     virtual bool insert(const boost::any& element, size_t pos) = 0;
+
+    /// Selects a codec for block compression (see BlockCodec), must be called before the first element is
+    /// written. An empty codec selects the uncompressed format.
+    /// @throw std::runtime_error if a codec is given to a writer that does not support compression, i.e. DensePropertyWriter
+    virtual void set_codec(const string& codec)
+    {
+        if (!codec.empty()) throw std::runtime_error("property writer does not support block compression (codec " + codec + ")");
+    }
+
+    /// Enables asynchronous writing, must be called before open(). Writers that support it then serialize
+    /// into memory and leave the file I/O to a background thread, others ignore this.
+    virtual void set_async(bool /*async*/) {}
+
+    /// Enables writing a sharded property file (see shard_manifest), must be called before open(). 0 disables
+    /// the respective limit.
+    /// @throw std::runtime_error if a limit is given to a writer that does not support sharding, i.e. DensePropertyWriter
+    virtual void set_shard_limits(index_t max_elements, int64_t max_bytes)
+    {
+        if (max_elements > 0 || max_bytes > 0) throw std::runtime_error("property writer does not support sharding");
+    }
+
+    /// Opens an existing file and continues writing after its last complete element, i.e. after the state
+    /// of the last checkpoint() if the writer has not been closed properly. Creates the file if it does not exist.
+    /// @throw std::runtime_error in case the file cannot be opened or is corrupt
+    virtual void open_append(const string& filename) = 0;
+
+    /// Number of elements in the file, including those present before open_append()
+    virtual index_t size() const = 0;
+
+    /// Makes the elements written so far survive a crash of the program, such that open_append() can continue from here.
+    /// @throw std::runtime_error if writing to the file failed
+    virtual void checkpoint() = 0;
+
+    /// Flushes all data and closes the file, afterwards no more elements can be written. Called by the
+    /// destructor if not called explicitly, but only an explicit call reports errors.
+    /// @throw std::runtime_error if writing to the file failed
+    virtual void close() = 0;
+
+    /// Serializes an element of the type passed to push_back() using imdb::io, independent of the file
+    /// the writer writes to. Used to store results elsewhere, e.g. in a DescriptorCache.
+    virtual void serialize(std::ostream& os, const boost::any& element) const = 0;
+
+    /// Reads an element stored by serialize(), element then holds the type expected by push_back()
+    virtual void deserialize(std::istream& is, boost::any& element) const = 0;
 };
 
 
@@ -49,7 +106,28 @@ struct PropertyWriter
  * free harddisk space. We have sucessfully generated files close to a Terabyte in size. The files are
  * directly portable between 64-bit and 32-bit machines but not portable between machines of differing endianness.
  *
- * Use PropertyReaderT to read in a property file that has been written with PropertyWriterT.
+ * After set_codec(), the file is written in the block-compressed format (version 3): elements are serialized
+ * into blocks of about block_bytes() bytes and each block is compressed independently. The offset of an element
+ * then is a virtual offset (block index << 32 | offset inside the uncompressed block), such that random access
+ * only needs to decompress a single block.
+ *
+ * After set_async(true), push_back() and insert() only serialize the element into an in-memory buffer. Full
+ * buffers (async_buffer_bytes()) are written by a background thread, such that the caller never waits for the
+ * disk unless async_queue_size() buffers are pending. close() (or the destructor) writes the remaining data.
+ *
+ * After set_shard_limits(), the file passed to open() becomes the manifest of a sharded property file (see shard_manifest).
+ * push_back() starts a new shard file whenever the current one holds max_elements elements or max_bytes bytes, this keeps
+ * individual files at a manageable size and lets them be read in parallel. insert() always writes into the current shard,
+ * i.e. it cannot be used for positions in shards that have already been finished.
+ *
+ * The offset table and the map are only written by close(). To not lose a long computation in case the program dies,
+ * call checkpoint() from time to time: it flushes all data to the file and appends the offsets added since the previous
+ * checkpoint to filename.checkpoint, which open_append() then uses to continue after the last checkpointed element. The
+ * cost of a checkpoint is thus proportional to the number of elements written since the previous one, not to the size
+ * of the file. open_append() also continues properly closed files (sharded or not), close() removes the checkpoint file.
+ *
+ * Use PropertyReaderT to read in a property file that has been written with PropertyWriterT, or ShardedPropertyReaderT for
+ * a sharded property file.
  *
  * Note: instances are noncopyable since they internally open files.
  *
@@ -66,41 +144,208 @@ public:
         return 2;
     }
 
-    PropertyWriterT() {}
+    // version of the block-compressed format
+    static int block_version()
+    {
+        return 3;
+    }
+
+    /// Size of the uncompressed blocks in the block-compressed format
+    static int64_t block_bytes()
+    {
+        return 1 << 20;
+    }
+
+    /// Size of the buffers handed to the flush thread in asynchronous mode
+    static int64_t async_buffer_bytes()
+    {
+        return 16 << 20;
+    }
+
+    /// Number of full buffers that may wait for the flush thread before push_back() blocks
+    static std::size_t async_queue_size()
+    {
+        return 4;
+    }
+
+    PropertyWriterT() : _checkpoint_offsets(0), _checkpoint_blocks(0), _max_elements(0), _max_bytes(0), _shard_first(0), _async(false), _pos(0), _write_error(false) {}
 
     /// Open the passed filename for writing, if the file aready exists, its content will be overwritten
-    PropertyWriterT(const string& filename)
+    PropertyWriterT(const string& filename) : _checkpoint_offsets(0), _checkpoint_blocks(0), _max_elements(0), _max_bytes(0), _shard_first(0), _async(false), _pos(0), _write_error(false)
     {
         this->open(filename);
     }
 
+    /// Open the passed filename for writing in the block-compressed format using the given codec
+    PropertyWriterT(const string& filename, const string& codec) : _checkpoint_offsets(0), _checkpoint_blocks(0), _max_elements(0), _max_bytes(0), _shard_first(0), _async(false), _pos(0), _write_error(false)
+    {
+        this->set_codec(codec);
+        this->open(filename);
+    }
+
+    /// Selects the codec for the block-compressed format, an empty string selects the uncompressed format
+    void set_codec(const string& codec)
+    {
+        assert(_offset.empty());
+        _codec_name = codec;
+        if (codec.empty()) _codec.reset();
+        else _codec = BlockCodec::create(codec);
+    }
+
+    /// Enables asynchronous mode, must be called before open()
+    void set_async(bool async)
+    {
+        assert(!_ofs.is_open());
+        _async = async;
+    }
+
+    /// Enables sharding, a new shard is started once the current one contains max_elements elements or max_bytes bytes,
+    /// 0 disables the respective limit. Must be called before open().
+    void set_shard_limits(index_t max_elements, int64_t max_bytes)
+    {
+        assert(!_ofs.is_open());
+        _max_elements = max_elements;
+        _max_bytes    = max_bytes;
+    }
+
     /// Open the passed filename for writing, if the file aready exists, its content will be overwritten
     void open(const string& filename)
     {
-        _ofs.open(filename.c_str(), std::ofstream::binary|std::ofstream::trunc);
-        if (!_ofs.is_open()) throw std::runtime_error("could not open file " + filename);
-        _map["__version"] = boost::lexical_cast<std::string>(version());
-        string type_name = imdb::nameof<T>();
-        _map["__typeinfo"] = type_name;
+        _filename = filename;
+        if (_max_elements > 0 || _max_bytes > 0)
+        {
+            _manifest_name       = filename;
+            _manifest            = shard_manifest();
+            _manifest.type_name  = imdb::nameof<T>();
+            _shard_first         = 0;
+            open_file(shard_manifest::resolve(filename, shard_manifest::shard_filename(filename, 0)));
+        }
+        else
+        {
+            _manifest_name.clear();
+            open_file(filename);
+        }
     }
 
+    /// Opens an existing file for appending, continuing after the last checkpoint if there is a checkpoint file,
+    /// otherwise after the last element of the (properly closed) file. The codec of the existing file is kept.
+    void open_append(const string& filename)
+    {
+        namespace fs = boost::filesystem;
 
-    ~PropertyWriterT()
+        if (fs::exists(checkpoint_filename(filename))) restore_checkpoint(filename);
+        else if (fs::exists(filename)) restore_file(filename);
+        else open(filename);
+    }
+
+    /// Number of elements in the file, for sharded files including the finished shards
+    index_t size() const
+    {
+        return _shard_first + _offset.size();
+    }
+
+    void serialize(std::ostream& os, const boost::any& element) const
+    {
+        io::write(os, boost::any_cast<const T&>(element));
+    }
+
+    void deserialize(std::istream& is, boost::any& element) const
+    {
+        T e;
+        io::read(is, e);
+
+        element = T();
+        using std::swap;
+        swap(boost::any_cast<T&>(element), e);
+    }
+
+    /// Flushes all data written so far to the file and appends the offsets added since the previous checkpoint
+    /// to the checkpoint file
+    void checkpoint()
+    {
+        assert(_ofs.is_open());
+        if (_codec) flush_block();
+
+        if (_async) stop_flush_thread();
+        _ofs.flush();
+        bool okay = !_write_error && _ofs.good();
+        if (_async) start_flush_thread();
+        if (!okay) throw std::runtime_error("PropertyWriterT: error while writing the file");
+
+        strmap_t map = _map;
+        map["__end"]   = boost::lexical_cast<std::string>(_pos);
+        map["__codec"] = _codec_name;
+        map["__sharded"] = _manifest_name.empty() ? "0" : "1";
+
+        std::vector<int64_t> shard_sizes;
+        for (std::size_t i = 0; i < _manifest.shards.size(); i++) shard_sizes.push_back(_manifest.shards[i].size);
+
+        // a record only holds the offsets (and blocks) added or changed since the previous checkpoint, the
+        // small map and shard table are repeated in each record
+        std::ostringstream record;
+        io::write(record, static_cast<int64_t>(_checkpoint_offsets));
+        io::write(record, std::vector<int64_t>(_offset.begin() + _checkpoint_offsets, _offset.end()));
+        io::write(record, static_cast<int64_t>(_checkpoint_blocks));
+        io::write(record, std::vector<int64_t>(_block_pos.begin() + _checkpoint_blocks, _block_pos.end()));
+        io::write(record, std::vector<int64_t>(_block_size.begin() + _checkpoint_blocks, _block_size.end()));
+        io::write(record, map);
+        io::write(record, shard_sizes);
+
+        string name = checkpoint_filename(_filename);
+        if (_checkpoint_offsets == 0 && _checkpoint_blocks == 0)
+        {
+            // the record describes the complete state, it replaces the checkpoint file (e.g. of a previous
+            // shard). Write to a temporary file first, such that a crash does not destroy the previous checkpoint.
+            string tmp = name + ".tmp";
+            {
+                std::ofstream ofs(tmp.c_str(), std::ofstream::binary|std::ofstream::trunc);
+                write_checkpoint_record(ofs, record.str());
+                if (!ofs.good()) throw std::runtime_error("PropertyWriterT: could not write checkpoint file " + tmp);
+            }
+            boost::filesystem::rename(tmp, name);
+        }
+        else
+        {
+            // a record that is cut off by a crash is detected by its checksum, restore_checkpoint() then uses the previous one
+            std::ofstream ofs(name.c_str(), std::ofstream::binary|std::ofstream::app);
+            write_checkpoint_record(ofs, record.str());
+            if (!ofs.good()) throw std::runtime_error("PropertyWriterT: could not write checkpoint file " + name);
+        }
+
+        _checkpoint_offsets = _offset.size();
+        _checkpoint_blocks  = _block_pos.size();
+    }
+
+    /// Writes the offset table, waits until all data has reached the file and closes it. For sharded
+    /// files, this also writes the manifest.
+    /// @throw std::runtime_error if writing to the file failed
+    void close()
     {
         if (!_ofs.is_open()) return;
 
-        int64_t p_features = 0;
-        _map["__features"] = boost::lexical_cast<std::string>(p_features);
+        index_t n = _offset.size();
+        close_file();
 
-        int64_t p_offsets = _ofs.tellp();
-        _map["__offsets"] = boost::lexical_cast<std::string>(p_offsets);
-        io::write(_ofs, _offset);
+        if (!_manifest_name.empty())
+        {
+            string shard = shard_manifest::shard_filename(_manifest_name, _manifest.shards.size());
+            _manifest.shards.push_back(shard_manifest::shard_t(_shard_first, n, shard));
+            _manifest.write(_manifest_name);
+        }
 
-        int64_t p_map = _ofs.tellp();
-        io::write(_ofs, _map);
-        io::write(_ofs, p_map);
+        boost::filesystem::remove(checkpoint_filename(_filename));
+    }
 
-        _ofs.close();
+    ~PropertyWriterT()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
     }
 
 
@@ -108,21 +353,23 @@ public:
     bool push_back(const boost::any& element)
     {
         assert(_ofs.is_open());
-        _offset.push_back(_ofs.tellp());
-        io::write(_ofs, boost::any_cast<T>(element));
-        assert(_ofs.good());
-        return true;
+        if (!_manifest_name.empty() && shard_full()) next_shard();
+        _offset.push_back(0);
+        return write_element(element, _offset.back());
     }
 
     /// Insert an element at an arbitrary position in the file
     bool insert(const boost::any& element, size_t pos)
     {
         assert(_ofs.is_open());
+        if (!_manifest_name.empty())
+        {
+            if (static_cast<index_t>(pos) < _shard_first) throw std::runtime_error("PropertyWriterT: cannot insert into a finished shard");
+            pos -= _shard_first;
+        }
+        if (pos < _checkpoint_offsets) _checkpoint_offsets = pos;
         if (_offset.size() <= pos) _offset.resize(pos + 1, -1);
-        _offset[pos] = _ofs.tellp();
-        io::write(_ofs, boost::any_cast<T>(element));
-        assert(_ofs.good());
-        return true;
+        return write_element(element, _offset[pos]);
     }
 
 
@@ -134,9 +381,588 @@ public:
 
 private:
 
+    // opens filename for writing, either truncating it or (if append_at >= 0) continuing at position append_at,
+    // everything after append_at is discarded in that case
+    void open_file(const string& filename, int64_t append_at = -1)
+    {
+        if (append_at < 0)
+        {
+            _ofs.open(filename.c_str(), std::ofstream::binary|std::ofstream::trunc);
+        }
+        else
+        {
+            if (static_cast<int64_t>(boost::filesystem::file_size(filename)) < append_at) throw std::runtime_error("file " + filename + " is shorter than expected");
+            boost::filesystem::resize_file(filename, append_at);
+            _ofs.open(filename.c_str(), std::ofstream::binary|std::ofstream::in);
+            _ofs.seekp(append_at);
+        }
+        if (!_ofs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        _offset.clear();
+        _map.clear();
+        _map["__version"] = boost::lexical_cast<std::string>(version());
+        string type_name = imdb::nameof<T>();
+        _map["__typeinfo"] = type_name;
+
+        _block.str(std::string());
+        _block.clear();
+        _block_pos.clear();
+        _block_size.clear();
+        _checkpoint_offsets = 0;
+        _checkpoint_blocks  = 0;
+
+        _pos = std::max<int64_t>(append_at, 0);
+        _write_error = false;
+        if (_async) start_flush_thread();
+    }
+
+    void close_file()
+    {
+        int64_t p_features = 0;
+        _map["__features"] = boost::lexical_cast<std::string>(p_features);
+
+        if (_codec)
+        {
+            flush_block();
+
+            int64_t p_blocks = _pos;
+            _pos += io::write(sink(), _block_pos);
+            _pos += io::write(sink(), _block_size);
+
+            _map["__version"] = boost::lexical_cast<std::string>(block_version());
+            _map["__codec"]   = _codec_name;
+            _map["__blocks"]  = boost::lexical_cast<std::string>(p_blocks);
+        }
+
+        int64_t p_offsets = _pos;
+        _map["__offsets"] = boost::lexical_cast<std::string>(p_offsets);
+        _pos += io::write(sink(), _offset);
+
+        int64_t p_map = _pos;
+        _pos += io::write(sink(), _map);
+        _pos += io::write(sink(), p_map);
+
+        if (_async) stop_flush_thread();
+
+        bool okay = !_write_error && _ofs.good();
+        _ofs.close();
+        if (!okay) throw std::runtime_error("PropertyWriterT: error while writing the file");
+    }
+
+    // true if the current shard has reached one of the limits
+    bool shard_full()
+    {
+        if (_offset.empty()) return false;
+        if (_max_elements > 0 && static_cast<index_t>(_offset.size()) >= _max_elements) return true;
+
+        int64_t bytes = _pos + (_codec ? static_cast<int64_t>(_block.tellp()) : 0);
+        return _max_bytes > 0 && bytes >= _max_bytes;
+    }
+
+    // finishes the current shard and starts the next one
+    void next_shard()
+    {
+        index_t n = _offset.size();
+        close_file();
+
+        string shard = shard_manifest::shard_filename(_manifest_name, _manifest.shards.size());
+        _manifest.shards.push_back(shard_manifest::shard_t(_shard_first, n, shard));
+        _shard_first += n;
+
+        open_file(shard_manifest::resolve(_manifest_name, shard_manifest::shard_filename(_manifest_name, _manifest.shards.size())));
+    }
+
+    static string checkpoint_filename(const string& filename)
+    {
+        return filename + ".checkpoint";
+    }
+
+    // a checkpoint record is stored as int64_t size, the data and its uint64_t fnv1a hash
+    static void write_checkpoint_record(std::ostream& os, const std::string& data)
+    {
+        io::write(os, static_cast<int64_t>(data.size()));
+        os.write(data.data(), data.size());
+        io::write(os, fnv1a(data.data(), data.size()));
+    }
+
+    // continues writing after the state stored by checkpoint(), i.e. after the last complete record of the checkpoint file
+    void restore_checkpoint(const string& filename)
+    {
+        string name = checkpoint_filename(filename);
+        std::ifstream ifs(name.c_str(), std::ifstream::binary);
+        if (!ifs.is_open()) throw std::runtime_error("could not open file " + name);
+        int64_t file_size = boost::filesystem::file_size(name);
+
+        strmap_t map;
+        std::vector<int64_t> offset, block_pos, block_size, shard_sizes;
+        bool found = false;
+        for (;;)
+        {
+            int64_t n = -1;
+            io::read(ifs, n);
+            if (!ifs.good() || n < 0 || n > file_size - static_cast<int64_t>(ifs.tellg())) break;
+
+            std::string data(n, '\0');
+            uint64_t hash = 0;
+            if (n > 0) ifs.read(&data[0], n);
+            io::read(ifs, hash);
+            if (!ifs.good() || hash != fnv1a(data.data(), data.size())) break;
+
+            std::istringstream record(data);
+            int64_t offsets_from = 0, blocks_from = 0;
+            std::vector<int64_t> offset_tail, block_pos_tail, block_size_tail;
+            strmap_t record_map;
+            std::vector<int64_t> record_shard_sizes;
+            io::read(record, offsets_from);
+            io::read(record, offset_tail);
+            io::read(record, blocks_from);
+            io::read(record, block_pos_tail);
+            io::read(record, block_size_tail);
+            io::read(record, record_map);
+            io::read(record, record_shard_sizes);
+            if (record.fail() || offsets_from > static_cast<int64_t>(offset.size()) || blocks_from > static_cast<int64_t>(block_pos.size())) break;
+
+            offset.resize(offsets_from);
+            offset.insert(offset.end(), offset_tail.begin(), offset_tail.end());
+            block_pos.resize(blocks_from);
+            block_pos.insert(block_pos.end(), block_pos_tail.begin(), block_pos_tail.end());
+            block_size.resize(blocks_from);
+            block_size.insert(block_size.end(), block_size_tail.begin(), block_size_tail.end());
+            map.swap(record_map);
+            shard_sizes.swap(record_shard_sizes);
+            found = true;
+        }
+        if (!found || !map.count("__end")) throw std::runtime_error("error while reading checkpoint file " + name);
+        check_type(map, filename);
+
+        _filename = filename;
+        _manifest_name.clear();
+        _manifest = shard_manifest();
+        _shard_first = 0;
+
+        string current = filename;
+        if (map["__sharded"] == "1")
+        {
+            _manifest_name      = filename;
+            _manifest.type_name = imdb::nameof<T>();
+            for (std::size_t i = 0; i < shard_sizes.size(); i++)
+            {
+                _manifest.shards.push_back(shard_manifest::shard_t(_shard_first, shard_sizes[i], shard_manifest::shard_filename(filename, i)));
+                _shard_first += shard_sizes[i];
+            }
+            current = shard_manifest::resolve(filename, shard_manifest::shard_filename(filename, shard_sizes.size()));
+        }
+
+        set_codec(map["__codec"]);
+        open_file(current, boost::lexical_cast<int64_t>(map["__end"]));
+        _offset.swap(offset);
+        _block_pos.swap(block_pos);
+        _block_size.swap(block_size);
+    }
+
+    // continues writing after the last element of a file that has been closed properly
+    void restore_file(const string& filename)
+    {
+        _filename = filename;
+        _manifest_name.clear();
+        _manifest = shard_manifest();
+        _shard_first = 0;
+
+        string current = filename;
+        if (is_sharded_property_file(filename))
+        {
+            _manifest.read(filename);
+            if (_manifest.shards.empty()) throw std::runtime_error("shard manifest " + filename + " contains no shards");
+            if (_manifest.type_name != imdb::nameof<T>()) throw std::runtime_error("error: elements stored in property file " + filename + " are of type " + _manifest.type_name);
+
+            // the last shard is continued
+            current = shard_manifest::resolve(filename, _manifest.shards.back().filename);
+            _shard_first = _manifest.shards.back().first;
+            _manifest.shards.pop_back();
+            _manifest_name = filename;
+        }
+
+        std::ifstream ifs(current.c_str(), std::ifstream::binary);
+        if (!ifs.is_open()) throw std::runtime_error("could not open file " + current);
+
+        ifs.seekg(-static_cast<int>(sizeof(int64_t)), std::ios::end);
+        int64_t p_map;
+        io::read(ifs, p_map);
+
+        strmap_t map;
+        ifs.seekg(p_map);
+        io::read(ifs, map);
+        if (!ifs.good() || !map.count("__version") || !map.count("__offsets")) throw std::runtime_error("error while reading map in file " + current);
+        check_type(map, current);
+
+        int p_version = boost::lexical_cast<int>(map["__version"]);
+        if (p_version != version() && p_version != block_version()) throw std::runtime_error("version of file " + current + " is different from program version");
+
+        // the offset table (and the block table) directly follow the elements
+        int64_t end = boost::lexical_cast<int64_t>(map["__offsets"]);
+        std::vector<int64_t> offset, block_pos, block_size;
+        ifs.seekg(end);
+        io::read(ifs, offset);
+
+        string codec;
+        if (p_version == block_version())
+        {
+            codec = map["__codec"];
+            end = boost::lexical_cast<int64_t>(map["__blocks"]);
+            ifs.seekg(end);
+            io::read(ifs, block_pos);
+            io::read(ifs, block_size);
+        }
+        if (!ifs.good()) throw std::runtime_error("error while reading file " + current);
+        ifs.close();
+
+        set_codec(codec);
+        open_file(current, end);
+        _offset.swap(offset);
+        _block_pos.swap(block_pos);
+        _block_size.swap(block_size);
+    }
+
+    static void check_type(strmap_t& map, const string& filename)
+    {
+        if (map["__typeinfo"] != imdb::nameof<T>())
+        {
+            throw std::runtime_error("error: elements stored in property file " + filename + " are of type " + map["__typeinfo"] + ". You are trying to write elements of type " + imdb::nameof<T>());
+        }
+    }
+
+    void start_flush_thread()
+    {
+        _queue.reset(new bounded_queue<shared_ptr<std::string> >(async_queue_size()));
+        _thread.reset(new boost::thread(boost::bind(&PropertyWriterT::flush_thread, this)));
+    }
+
+    // hands over the remaining data and waits until the flush thread has written everything
+    void stop_flush_thread()
+    {
+        hand_off(true);
+        _queue->close();
+        _thread->join();
+        _thread.reset();
+        _queue.reset();
+    }
+
+    // in asynchronous mode everything is serialized into _buffer, otherwise directly into the file
+    std::ostream& sink()
+    {
+        if (_async) return _buffer;
+        return _ofs;
+    }
+
+    bool write_element(const boost::any& element, int64_t& offset)
+    {
+        if (_codec)
+        {
+            offset = (static_cast<int64_t>(_block_pos.size()) << 32) | static_cast<int64_t>(_block.tellp());
+            io::write(_block, boost::any_cast<const T&>(element));
+            if (_block.tellp() >= block_bytes()) flush_block();
+        }
+        else
+        {
+            offset = _pos;
+            _pos += io::write(sink(), boost::any_cast<const T&>(element));
+        }
+
+        if (_async) return hand_off(false);
+        return _ofs.good();
+    }
+
+    // compresses the current block and writes it as int64_t compressed size followed by the compressed data
+    void flush_block()
+    {
+        std::string data = _block.str();
+        if (data.empty()) return;
+
+        if (data.size() >> 32) throw std::runtime_error("PropertyWriterT: element too large for the block-compressed format");
+
+        std::vector<char> encoded;
+        _codec->encode(data.data(), data.size(), encoded);
+
+        _block_pos.push_back(_pos);
+        _block_size.push_back(data.size());
+        _pos += io::write(sink(), static_cast<int64_t>(encoded.size()));
+        if (!encoded.empty()) sink().write(&encoded[0], encoded.size());
+        _pos += encoded.size();
+
+        _block.str(std::string());
+        _block.clear();
+    }
+
+    // passes _buffer to the flush thread once it is full (or always if force is set),
+    // blocks while the flush thread is behind by async_queue_size() buffers
+    bool hand_off(bool force)
+    {
+        if (_buffer.tellp() <= 0) return !_write_error;
+        if (!force && _buffer.tellp() < async_buffer_bytes()) return !_write_error;
+
+        shared_ptr<std::string> data(new std::string(_buffer.str()));
+        _buffer.str(std::string());
+        _buffer.clear();
+
+        return _queue->push(data) && !_write_error;
+    }
+
+    // runs in its own thread, the only place that touches _ofs in asynchronous mode
+    void flush_thread()
+    {
+        shared_ptr<std::string> data;
+        while (_queue->pop(data))
+        {
+            if (_write_error) continue;
+
+            _ofs.write(data->data(), data->size());
+            if (!_ofs.good())
+            {
+                // makes further push_back() calls fail instead of blocking
+                _write_error = true;
+                _queue->close();
+            }
+        }
+    }
+
     std::ofstream        _ofs;
     std::vector<int64_t> _offset;
     strmap_t             _map;
+
+    // only used in the block-compressed format
+    shared_ptr<BlockCodec> _codec;
+    string                 _codec_name;
+    std::ostringstream     _block;
+    std::vector<int64_t>   _block_pos;
+    std::vector<int64_t>   _block_size;
+
+    // name passed to open(), also determines the name of the checkpoint file
+    string                 _filename;
+
+    // number of offsets and blocks of the current file covered by the checkpoint file
+    std::size_t            _checkpoint_offsets;
+    std::size_t            _checkpoint_blocks;
+
+    // only used for sharded files
+    string                 _manifest_name;
+    shard_manifest         _manifest;
+    index_t                _max_elements;
+    int64_t                _max_bytes;
+    index_t                _shard_first;
+
+    bool                 _async;
+
+    // file position of the next byte, tracked without tellp() such that it also works in asynchronous mode
+    int64_t              _pos;
+
+    // only used in asynchronous mode
+    std::ostringstream                                 _buffer;
+    shared_ptr<bounded_queue<shared_ptr<std::string> > > _queue;
+    shared_ptr<boost::thread>                          _thread;
+    volatile bool                                      _write_error;
+};
+
+
+
+/**
+ * @brief PropertyWriterT that converts each element from from_t to to_t before writing it.
+ *
+ * This lets a Generator that computes e.g. vec_f32_t features store them as vec_f16_t or vec_q8_t
+ * without changing its compute() function, see PropertyWriters::add_converted(). Conversion is done
+ * using the convert() overloads from reduced_precision.hpp.
+ */
+template <class from_t, class to_t>
+class ConvertingPropertyWriterT : public PropertyWriterT<to_t>
+{
+public:
+
+    bool push_back(const boost::any& element)
+    {
+        to_t converted;
+        convert(boost::any_cast<const from_t&>(element), converted);
+        return PropertyWriterT<to_t>::push_back(converted);
+    }
+
+    bool insert(const boost::any& element, size_t pos)
+    {
+        to_t converted;
+        convert(boost::any_cast<const from_t&>(element), converted);
+        return PropertyWriterT<to_t>::insert(converted, pos);
+    }
+
+    // elements are serialized unconverted, deserialize() must return from_t again
+    void serialize(std::ostream& os, const boost::any& element) const
+    {
+        io::write(os, boost::any_cast<const from_t&>(element));
+    }
+
+    void deserialize(std::istream& is, boost::any& element) const
+    {
+        from_t e;
+        io::read(is, e);
+
+        element = from_t();
+        using std::swap;
+        swap(boost::any_cast<from_t&>(element), e);
+    }
+};
+
+
+/**
+ * @brief Writes a dense property file containing fixed-dimension vec_f32_t elements.
+ *
+ * Has the same interface as PropertyWriterT<vec_f32_t> but writes the dense format described in
+ * dense_header: no per-element length prefix, no offset table, each row aligned to 64 bytes.
+ * This is the preferred format for global descriptors and vocabularies, use read_property(FeatureMatrix&, const string&)
+ * to load such a file with a single read.
+ *
+ * The first element written determines the dimension of all elements in the file, pushing an element
+ * of a different size throws std::runtime_error. Rows that are never written when using insert()
+ * are zero-filled.
+ */
+class DensePropertyWriter : public PropertyWriter, boost::noncopyable
+{
+public:
+
+    DensePropertyWriter() : _has_cols(false) {}
+
+    /// Open the passed filename for writing, if the file aready exists, its content will be overwritten
+    DensePropertyWriter(const string& filename) : _has_cols(false)
+    {
+        this->open(filename);
+    }
+
+    /// Open the passed filename for writing, if the file aready exists, its content will be overwritten
+    void open(const string& filename)
+    {
+        _ofs.open(filename.c_str(), std::ofstream::binary|std::ofstream::trunc);
+        if (!_ofs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        // placeholder, the final header is written by close()
+        _header = dense_header();
+        _has_cols = false;
+        _header.write(_ofs);
+    }
+
+    /// Opens an existing dense property file and continues writing after its last row, i.e. the last row
+    /// at the time of the last checkpoint() if the writer has not been closed properly
+    void open_append(const string& filename)
+    {
+        if (!boost::filesystem::exists(filename))
+        {
+            open(filename);
+            return;
+        }
+
+        {
+            std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+            _header.read(ifs);
+        }
+
+        _ofs.open(filename.c_str(), std::ofstream::binary|std::ofstream::in);
+        if (!_ofs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        _has_cols = _header.stride > 0;
+        _padding.assign(_header.stride - _header.cols, 0.0f);
+    }
+
+    index_t size() const
+    {
+        return _header.rows;
+    }
+
+    void serialize(std::ostream& os, const boost::any& element) const
+    {
+        io::write(os, boost::any_cast<const vec_f32_t&>(element));
+    }
+
+    void deserialize(std::istream& is, boost::any& element) const
+    {
+        vec_f32_t e;
+        io::read(is, e);
+
+        element = vec_f32_t();
+        boost::any_cast<vec_f32_t&>(element).swap(e);
+    }
+
+    /// Updates the header such that it covers all rows written so far
+    void checkpoint()
+    {
+        assert(_ofs.is_open());
+        _ofs.seekp(0);
+        _header.write(_ofs);
+        _ofs.flush();
+        if (!_ofs.good()) throw std::runtime_error("DensePropertyWriter: error while writing the file");
+    }
+
+    /// Writes the final header and closes the file
+    /// @throw std::runtime_error if writing to the file failed
+    void close()
+    {
+        if (!_ofs.is_open()) return;
+
+        _ofs.seekp(0);
+        _header.write(_ofs);
+
+        bool okay = _ofs.good();
+        _ofs.close();
+        if (!okay) throw std::runtime_error("DensePropertyWriter: error while writing the file");
+    }
+
+    ~DensePropertyWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    /// Append an element to the end of the file
+    bool push_back(const boost::any& element)
+    {
+        return insert(element, _header.rows);
+    }
+
+    /// Insert an element at an arbitrary position in the file
+    bool insert(const boost::any& element, size_t pos)
+    {
+        assert(_ofs.is_open());
+        const vec_f32_t& v = boost::any_cast<const vec_f32_t&>(element);
+
+        if (!_has_cols)
+        {
+            _header.cols   = v.size();
+            _header.stride = FeatureMatrix::aligned_stride(v.size());
+            _padding.resize(_header.stride - _header.cols, 0.0f);
+            _has_cols = true;
+        }
+
+        if (static_cast<int64_t>(v.size()) != _header.cols)
+        {
+            throw std::runtime_error("DensePropertyWriter: all elements must have the same size");
+        }
+
+        int64_t p = dense_header::size() + static_cast<int64_t>(pos) * _header.stride * sizeof(float);
+        if (p != _ofs.tellp()) _ofs.seekp(p);
+
+        if (!v.empty()) _ofs.write(reinterpret_cast<const char*>(&v[0]), v.size() * sizeof(float));
+        if (!_padding.empty()) _ofs.write(reinterpret_cast<const char*>(&_padding[0]), _padding.size() * sizeof(float));
+        assert(_ofs.good());
+
+        _header.rows = std::max<int64_t>(_header.rows, pos + 1);
+        return true;
+    }
+
+private:
+
+    std::ofstream _ofs;
+    dense_header  _header;
+    bool          _has_cols;
+    vec_f32_t     _padding;
 };
 
 
@@ -167,6 +993,27 @@ void write_property(const std::vector<T>& v, const std::string& filename)
     PropertyWriterT<T> wr;
     wr.open(filename);
     for (size_t i = 0; i < v.size(); i++) wr.push_back(v[i]);
+    wr.close();
+}
+
+/**
+ * @brief Writes a complete FeatureMatrix as a dense property file.
+ *
+ * As the in-memory layout of FeatureMatrix matches the file layout, this is a single write.
+ */
+inline void write_property(const FeatureMatrix& m, const std::string& filename)
+{
+    std::ofstream ofs(filename.c_str(), std::ofstream::binary|std::ofstream::trunc);
+    if (!ofs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+    dense_header header;
+    header.rows   = m.rows();
+    header.cols   = m.cols();
+    header.stride = m.stride();
+    header.write(ofs);
+
+    if (!m.empty()) ofs.write(reinterpret_cast<const char*>(m.data()), m.rows() * m.stride() * sizeof(float));
+    if (!ofs.good()) throw std::runtime_error("error while writing file " + filename);
 }
 
 
@@ -202,6 +1049,79 @@ public:
         return *this;
     }
 
+    /**
+     * @brief Add a PropertyWriterT that receives elements of type from_t but stores them as to_t.
+     *
+     * Typically used to store features in reduced precision, e.g. add_converted<vec_f32_t, vec_f16_t>("features").
+     * @param name name of the writer to be added
+     */
+    template <class from_t, class to_t>
+    PropertyWriters& add_converted(const std::string& name)
+    {
+        _properties[name] = make_shared<ConvertingPropertyWriterT<from_t, to_t> >();
+        return *this;
+    }
+
+    /**
+     * @brief Add a DensePropertyWriter to the current map of writers.
+     *
+     * Use this instead of add<vec_f32_t>() for fixed-dimension descriptors.
+     * @param name name of the DensePropertyWriter to be added
+     */
+    PropertyWriters& add_dense(const std::string& name)
+    {
+        _properties[name] = make_shared<DensePropertyWriter>();
+        return *this;
+    }
+
+    /**
+     * @brief Add a writer for vec_f32_t elements: a DensePropertyWriter if dense, a writer that stores
+     * vec_f16_t or vec_q8_t elements if precision is "f16" or "q8", otherwise a PropertyWriterT<vec_f32_t>.
+     *
+     * For generators of fixed-dimension descriptors that let the user choose the file format,
+     * see the generator.dense_features and generator.feature_precision parameters of gist and tinyimage.
+     * @param name name of the writer to be added
+     * @param precision "f32", "f16" or "q8"
+     * @throw std::runtime_error for an unknown precision or a reduced precision together with dense
+     */
+    PropertyWriters& add_vectors(const std::string& name, bool dense, const std::string& precision = "f32")
+    {
+        check_precision(precision);
+        if (dense && precision != "f32") throw std::runtime_error("dense property files only support feature precision f32");
+
+        if (precision == "f16") return add_converted<vec_f32_t, vec_f16_t>(name);
+        if (precision == "q8")  return add_converted<vec_f32_t, vec_q8_t>(name);
+        if (dense) return add_dense(name);
+        return add<vec_f32_t>(name);
+    }
+
+    /**
+     * @brief Add a writer for RaggedMatrix elements (local features) that stores each row as vec_f16_t or vec_q8_t
+     * if precision is "f16" or "q8", otherwise a PropertyWriterT<RaggedMatrix>.
+     *
+     * See the generator.feature_precision parameter of galif and shog.
+     * @param name name of the writer to be added
+     * @param precision "f32", "f16" or "q8"
+     * @throw std::runtime_error for an unknown precision
+     */
+    PropertyWriters& add_local_features(const std::string& name, const std::string& precision = "f32")
+    {
+        check_precision(precision);
+
+        if (precision == "f16") return add_converted<RaggedMatrix, std::vector<vec_f16_t> >(name);
+        if (precision == "q8")  return add_converted<RaggedMatrix, std::vector<vec_q8_t> >(name);
+        return add<RaggedMatrix>(name);
+    }
+
+    /**
+     * @brief Add an existing writer under the given name, e.g. to combine the writers of several generators.
+     */
+    PropertyWriters& add(const std::string& name, shared_ptr<PropertyWriter> writer)
+    {
+        _properties[name] = writer;
+        return *this;
+    }
+
     // Note: can't make this function const as a common usecase is that
     // we actually want to open() the writers for writing data to a file
     properties_t& get()
@@ -211,6 +1131,11 @@ public:
 
 private:
 
+    static void check_precision(const std::string& precision)
+    {
+        if (precision != "f32" && precision != "f16" && precision != "q8") throw std::runtime_error("unknown feature precision " + precision + ", must be f32, f16 or q8");
+    }
+
     properties_t _properties;
 };
 
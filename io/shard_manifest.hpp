@@ -0,0 +1,148 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef SHARD_MANIFEST_HPP
+#define SHARD_MANIFEST_HPP
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <stdexcept>
+
+#include "../util/types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup io
+ * @brief Manifest of a sharded property file.
+ *
+ * A sharded property file consists of several regular property files (the shards), each holding a
+ * consecutive range of elements, and a small manifest listing them. The manifest is a text file:
+ *
+ * @code
+ * IMDBSHD1
+ * typeinfo vector<float>
+ * shards 2
+ * 0 1000000 features.shard00000
+ * 1000000 873311 features.shard00001
+ * @endcode
+ *
+ * Each shard line contains the index of its first element, its number of elements and its filename.
+ * Relative filenames are relative to the directory of the manifest, such that the files can be moved
+ * together. Absolute filenames allow putting shards on different disks.
+ */
+struct shard_manifest
+{
+    static const char* magic() { return "IMDBSHD1"; }
+
+    struct shard_t
+    {
+        shard_t() : first(0), size(0) {}
+        shard_t(index_t first_, index_t size_, const string& filename_) : first(first_), size(size_), filename(filename_) {}
+
+        index_t first;
+        index_t size;
+        string  filename;
+    };
+
+    string               type_name;
+    std::vector<shard_t> shards;
+
+    /// Total number of elements in all shards
+    index_t size() const
+    {
+        return shards.empty() ? 0 : shards.back().first + shards.back().size;
+    }
+
+    /// Filename of shard i as written by PropertyWriterT, i.e. relative to the manifest
+    static string shard_filename(const string& manifest, std::size_t i)
+    {
+        std::size_t slash = manifest.find_last_of("/\\");
+        string base = (slash == string::npos) ? manifest : manifest.substr(slash + 1);
+
+        std::ostringstream os;
+        os << base << ".shard";
+        os.width(5);
+        os.fill('0');
+        os << i;
+        return os.str();
+    }
+
+    /// Resolves the filename of a shard entry against the location of the manifest
+    static string resolve(const string& manifest, const string& filename)
+    {
+        if (!filename.empty() && (filename[0] == '/' || filename[0] == '\\' || filename.find(':') != string::npos)) return filename;
+
+        std::size_t slash = manifest.find_last_of("/\\");
+        return (slash == string::npos) ? filename : manifest.substr(0, slash + 1) + filename;
+    }
+
+    /// @throw std::runtime_error in case the file cannot be written
+    void write(const string& filename) const
+    {
+        std::ofstream ofs(filename.c_str(), std::ofstream::trunc);
+        if (!ofs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        ofs << magic() << "\n";
+        ofs << "typeinfo " << type_name << "\n";
+        ofs << "shards " << shards.size() << "\n";
+        for (std::size_t i = 0; i < shards.size(); i++)
+        {
+            ofs << shards[i].first << " " << shards[i].size << " " << shards[i].filename << "\n";
+        }
+
+        if (!ofs.good()) throw std::runtime_error("error while writing file " + filename);
+    }
+
+    /// @throw std::runtime_error in case the file cannot be read or is not a valid manifest
+    void read(const string& filename)
+    {
+        std::ifstream ifs(filename.c_str());
+        if (!ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+        string line, key;
+        std::getline(ifs, line);
+        if (line != magic()) throw std::runtime_error("file " + filename + " is not a shard manifest");
+
+        ifs >> key;
+        std::getline(ifs >> std::ws, type_name);
+        if (key != "typeinfo") throw std::runtime_error("error while reading shard manifest " + filename);
+
+        std::size_t n = 0;
+        ifs >> key >> n;
+        if (key != "shards") throw std::runtime_error("error while reading shard manifest " + filename);
+
+        shards.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            ifs >> shards[i].first >> shards[i].size;
+            std::getline(ifs >> std::ws, shards[i].filename);
+
+            index_t expected = (i == 0) ? 0 : shards[i - 1].first + shards[i - 1].size;
+            if (!ifs || shards[i].first != expected) throw std::runtime_error("error while reading shard manifest " + filename);
+        }
+    }
+};
+
+
+/**
+ * @ingroup io
+ * @brief Checks whether filename is the manifest of a sharded property file.
+ */
+inline bool is_sharded_property_file(const std::string& filename)
+{
+    std::ifstream ifs(filename.c_str(), std::ifstream::binary);
+    char m[8];
+    ifs.read(m, 8);
+    return ifs.good() && std::memcmp(m, shard_manifest::magic(), 8) == 0;
+}
+
+} // namespace imdb
+
+#endif // SHARD_MANIFEST_HPP
@@ -20,6 +20,9 @@ the terms of the BSD license (see the LICENSE file).
 #include <boost/cstdint.hpp>
 #include <boost/static_assert.hpp>
 
+#include "../util/reduced_precision.hpp"
+#include "../util/ragged_matrix.hpp"
+
 
 namespace imdb
 {
@@ -105,6 +108,19 @@ DEF_TYPE_NAME(bool)
 DEF_TYPE_NAME(char)
 DEF_TYPE_NAME(std::string)
 
+DEF_TYPE_NAME(float16_t)
+DEF_TYPE_NAME(vec_q8_t)
+
+// RaggedMatrix is stored exactly like a vector<vector<float> > and therefore also has
+// the same name, this makes both types interchangeable when reading/writing properties
+template <> struct type_name<RaggedMatrix>
+{
+    std::string name() const
+    {
+        return type_name<std::vector<std::vector<float> > >().name();
+    }
+};
+
 template <class T> inline std::string nameof(T = T())
 {
     return type_name<T>().name();
@@ -22,6 +22,10 @@ the terms of the BSD license (see the LICENSE file).
 // describe the distance between two descriptors and thus smaller
 // distances denote more similar objects. The dotproduct itself
 // e.g. is NOT a distance measure, it is a similarity measure
+//
+// All functors compare two arbitrary ranges of equal length, e.g.
+// a vec_f32_t against a zero-copy view from PropertyReaderT::view().
+// T only defines the argument types of the stl typedefs.
 // ----------------------------------------------------------------
 
 
@@ -45,10 +49,12 @@ struct l1norm
     typedef R result_type;
 
     /// L1 distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R d = static_cast<R>(*ai) - static_cast<R>(*bi);
             s += std::abs(d);
@@ -72,10 +78,12 @@ struct l2norm_squared
     typedef R result_type;
 
     /// Squared L2 distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R d = static_cast<R>(*ai) - static_cast<R>(*bi);
             s += d*d;
@@ -99,7 +107,8 @@ struct l2norm
     l2norm_squared<T,R> n;
 
     /// L2 (Euclidean) distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         return std::sqrt(n(a,b));
     }
@@ -123,10 +132,12 @@ struct one_minus_dot
 
     /// Computes 1 - <a,b>. As we assume that both a and b have unit length, the
     /// result is guaranteed to lie in [0,2]
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             s += static_cast<R>(*ai) * static_cast<R>(*bi);
         }
@@ -143,10 +154,12 @@ struct jsd
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R v0 = *ai;
             R v1 = *bi;
@@ -177,10 +190,12 @@ struct chi2
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R v0 = *ai;
             R v1 = *bi;
@@ -210,7 +225,8 @@ struct dist_frobenius
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         assert(a.size() % 3 == 0);
         assert(a.size() == b.size());
@@ -269,7 +285,8 @@ struct dist_df
      * @param b
      * @return Computes <a,dt(b)> + <b,dt(a)>, result range is [0,inf] where 0 means that a and b are equal
      */
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         assert(a.size() % 2 == 0);
         assert(a.size() == b.size());
@@ -317,16 +334,26 @@ struct distance_functions<std::vector<X>, R>
 
     distfn_t make(const std::string& name)
     {
-        if (name == "l1norm") return l1norm<T>();
-        if (name == "l2norm") return l2norm<T>();
-        if (name == "l2norm_squared") return l2norm_squared<T>();
-        if (name == "jsd") return jsd<T>();
-        if (name == "chi2") return chi2<T>();
-        if (name == "one_minus_dot") return one_minus_dot<T>();
-        if (name == "df") return dist_df<T>();
-        if (name == "frobenius") return dist_frobenius<T>();
+        return make<T, T>(name);
+    }
 
-        return distfn_t();
+    /// Same as make() but comparing a descriptor of type A against one of type B,
+    /// typically a vector<X> query against a zero-copy view of the same length.
+    template <class A, class B>
+    boost::function<R (const A&, const B&)> make(const std::string& name)
+    {
+        typedef boost::function<R (const A&, const B&)> fn_t;
+
+        if (name == "l1norm") return l1norm<T, R>();
+        if (name == "l2norm") return l2norm<T, R>();
+        if (name == "l2norm_squared") return l2norm_squared<T, R>();
+        if (name == "jsd") return jsd<T, R>();
+        if (name == "chi2") return chi2<T, R>();
+        if (name == "one_minus_dot") return one_minus_dot<T, R>();
+        if (name == "df") return dist_df<T, R>();
+        if (name == "frobenius") return dist_frobenius<T, R>();
+
+        return fn_t();
     }
 };
 
@@ -32,7 +32,12 @@ InvertedIndex::InvertedIndex(unsigned int num_words)
 
 void InvertedIndex::addHistogram(const vec_f32_t &histogram) {
 
-    assert(histogram.size() == _numWords);
+    addHistogram(histogram.empty() ? 0 : &histogram[0], histogram.size());
+}
+
+void InvertedIndex::addHistogram(const float* histogram, size_t size) {
+
+    assert(size == _numWords);
 
     // when the last document has been added, the index needs
     // to be finalized (call to finalize()). Only then
@@ -44,7 +49,7 @@ void InvertedIndex::addHistogram(const vec_f32_t &histogram) {
     float numWords = 0;
     int numUniqueWords = 0;
 
-    for (size_t t = 0; t < histogram.size(); t++)
+    for (size_t t = 0; t < size; t++)
     {
 
         float f_dt = histogram[t];
@@ -79,6 +79,13 @@ public:
      */
     void addHistogram(const vec_f32_t& histogram);
 
+    /**
+     * @brief Same as addHistogram(const vec_f32_t&) but operating on a plain array of \p size frequencies.
+     *
+     * Lets you add histograms straight from a memory-mapped property file (see PropertyReaderT::view()).
+     */
+    void addHistogram(const float* histogram, size_t size);
+
 
     /**
      * @brief Finalizes the index \b after the last document has been added.
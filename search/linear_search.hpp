@@ -31,9 +31,13 @@ the terms of the BSD license (see the LICENSE file).
  * The result is always a container class containing at each index
  * a std::pair(distance, index), where index points into the features
  * collection.
+ *
+ * storage_t only needs to provide size() and operator[], so besides a
+ * std::vector this also works on PropertyReaderT::views_t, i.e. directly on
+ * a memory-mapped property file without deserializing it first.
  */
-template <class storage_t, class result_t, class distfn_t>
-void linear_search(const typename storage_t::value_type& query_feature, const storage_t& features, result_t& result, size_t num_results, const distfn_t& distfn)
+template <class query_t, class storage_t, class result_t, class distfn_t>
+void linear_search(const query_t& query_feature, const storage_t& features, result_t& result, size_t num_results, const distfn_t& distfn)
 {
 
     using namespace std;
@@ -19,14 +19,34 @@ LinearSearchManager::LinearSearchManager(const ptree& parameters)
 {
     string filename = parameters.get<string>("descriptor_file");
     string distfn_str = parameters.get<string>("distfn");
+    bool mmap = parameters.get<bool>("mmap", false);
 
     // try to create distance function object
-    _distfn = distance_functions<vec_f32_t>().make(distfn_str);
+    _distfn = distance_functions<vec_f32_t>().make<vec_f32_t, FeatureMatrix::const_row>(distfn_str);
     if (!_distfn) throw std::runtime_error("unknown distance function: " + distfn_str);
 
-    // try to load features
+    // try to load (or map) features
     try {
-        read_property(_features, filename);
+        string type_name = property_type_name(filename);
+        if (type_name == nameof<vec_f16_t>())
+        {
+            _distfn_f16 = distance_functions<vec_f32_t>().make<vec_f32_t, vec_f16_t>(distfn_str);
+            read_property(_features_f16, filename);
+            return;
+        }
+        if (type_name == nameof<vec_q8_t>())
+        {
+            _distfn_q8 = distance_functions<vec_f32_t>().make<vec_f32_t, vec_q8_t>(distfn_str);
+            read_property(_features_q8, filename);
+            return;
+        }
+
+        if (mmap && !is_dense_property_file(filename)) _reader.reset(new reader_t(filename, PropertyAccessMapped));
+
+        // block-compressed files cannot be searched in place
+        if (_reader && _reader->compressed()) _reader.reset();
+
+        if (!_reader) read_property(_features, filename);
     } catch(std::exception& e) {
         std::cerr << "LinearSearchManager: exception occured when trying to load features file: " + filename << std::endl;
         std::cerr << e.what() << std::endl;
@@ -36,8 +56,50 @@ LinearSearchManager::LinearSearchManager(const ptree& parameters)
 
 void LinearSearchManager::query(const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& result) const
 {
+    if (_distfn_f16)
+    {
+        linear_search(descr, _features_f16, result, std::min(num_results, _features_f16.size()), _distfn_f16);
+        return;
+    }
+
+    if (_distfn_q8)
+    {
+        linear_search(descr, _features_q8, result, std::min(num_results, _features_q8.size()), _distfn_q8);
+        return;
+    }
+
+    if (_reader)
+    {
+        size_t max_num_results = std::min<size_t>(num_results, _reader->size());
+        linear_search(descr, _reader->views(), result, max_num_results, _distfn);
+        return;
+    }
+
     size_t max_num_results = std::min(num_results, _features.size());
     linear_search(descr, _features, result, max_num_results, _distfn);
 }
 
+const vec_vec_f32_t& LinearSearchManager::features()
+{
+    if (!_features_f32.empty()) return _features_f32;
+
+    if (!_features_f16.empty()) convert(_features_f16, _features_f32);
+    else if (!_features_q8.empty()) convert(_features_q8, _features_f32);
+    else if (_reader)
+    {
+        _features_f32.resize(_reader->size());
+        for (index_t i = 0; i < _reader->size(); i++)
+        {
+            boost::iterator_range<const float*> v = _reader->view(i);
+            _features_f32[i].assign(v.begin(), v.end());
+        }
+    }
+    else
+    {
+        _features_f32.resize(_features.size());
+        for (size_t i = 0; i < _features.size(); i++) _features_f32[i].assign(_features[i].begin(), _features[i].end());
+    }
+    return _features_f32;
+}
+
 } // namespace imdb
@@ -10,6 +10,8 @@ the terms of the BSD license (see the LICENSE file).
 #define LINEAR_SEARCH_HPP
 
 #include "../util/types.hpp"
+#include "../util/feature_matrix.hpp"
+#include "../io/property_reader.hpp"
 #include "distance.hpp"
 
 namespace imdb
@@ -21,8 +23,9 @@ namespace imdb
  *
  * Encapsulates loading of the required datastructures and distance metric
  * such that a search can be performed once the instance has been constructed.
- * Note that this class loads \b all features into main memory, make sure
- * that you have enough memory to do so.
+ * Note that this class loads \b all features into main memory (as a single FeatureMatrix),
+ * make sure that you have enough memory to do so. Alternatively, set "mmap" to true in
+ * the parameters: the features file is then memory-mapped and searched in place.
  */
 class LinearSearchManager
 {
@@ -34,9 +37,13 @@ class LinearSearchManager
      * @brief Constructs the LinearSearchManager, loads all required datastructures such that a query() can be performed.
      * @param parameters boost::property_tree that must contain the following key/value pairs:
      * - "descriptor_file": filename of the features file over which you want to perform linear search, e.g. "/tmp/tinyimage.features". The
-     * features file must have been created using a PropertyWriterT with T=vec_f32_t.
+     * features file must have been created using a DensePropertyWriter or a PropertyWriterT with T=vec_f32_t. Files with
+     * reduced precision elements (T=vec_f16_t or T=vec_q8_t) are kept in that compact representation in main memory.
      * - "distfn": distance function, can be "l1norm", "l2norm", "l2norm_squared" or any other sensible distance metric available
      * via distance_functions<T>.make()
+     * - "mmap": optional, defaults to false. If true, the features file is memory-mapped instead of being loaded, this
+     * avoids deserializing the whole file and makes construction nearly instantaneous if the file is in the page cache.
+     * Dense and block-compressed features files are always loaded.
      */
     LinearSearchManager(const ptree& parameters);
 
@@ -54,12 +61,34 @@ class LinearSearchManager
      * in the property file that has been searched.
      */
     void query(const vec_f32_t& data, size_t num_results, vector<dist_idx_t>& result) const;
-    const vec_vec_f32_t& features() {return _features;}
+
+    /// All features as vec_vec_f32_t, converted from the loaded (or mapped) features on the first call
+    const vec_vec_f32_t& features();
+
+    /// The features loaded by the constructor, empty in "mmap" mode and for files with reduced precision elements
+    const FeatureMatrix& feature_matrix() const {return _features;}
 
     private:
 
-    vec_vec_f32_t _features;
-    distance_functions<vec_f32_t>::distfn_t _distfn;
+    typedef PropertyReaderT<vec_f32_t> reader_t;
+
+    // rows of a FeatureMatrix and views into a mapped file are the same type
+    typedef boost::function<float (const vec_f32_t&, const FeatureMatrix::const_row&)> row_distfn_t;
+
+    FeatureMatrix _features;
+    row_distfn_t  _distfn;
+
+    // only used in "mmap" mode
+    shared_ptr<reader_t> _reader;
+
+    // only used for files with reduced precision elements
+    std::vector<vec_f16_t> _features_f16;
+    std::vector<vec_q8_t>  _features_q8;
+    boost::function<float (const vec_f32_t&, const vec_f16_t&)> _distfn_f16;
+    boost::function<float (const vec_f32_t&, const vec_q8_t&)>  _distfn_q8;
+
+    // only filled by features()
+    vec_vec_f32_t _features_f32;
 };
 
 } // namespace imdb
@@ -18,10 +18,17 @@ SOURCES += main.cpp \
     descriptors/gist.cpp \
     descriptors/shog.cpp \
     descriptors/galif.cpp \
+    descriptors/multi_generator.cpp \
     descriptors/image_sampler.cpp \
     descriptors/utilities.cpp \
+    descriptors/simd_kernels.cpp \
+    descriptors/tile_aggregator.cpp \
+    descriptors/filter_bank_cache.cpp \
     io/compute_descriptors.cpp \
-    io/ordered_push_back.cpp
+    io/ordered_push_back.cpp \
+    io/compute_stats.cpp \
+    io/descriptor_cache.cpp \
+    io/image_loader.cpp
 
 
 HEADERS += util/types.hpp \
@@ -31,10 +38,19 @@ HEADERS += util/types.hpp \
     io/filelist.hpp \
     descriptors/image_sampler.hpp \
     descriptors/utilities.hpp \
+    descriptors/simd_kernels.hpp \
+    descriptors/tile_aggregator.hpp \
+    descriptors/filter_bank_cache.hpp \
     descriptors/generator.hpp \
     descriptors/tinyimage.hpp \
     descriptors/gist.hpp \
     descriptors/shog.hpp \
     descriptors/galif.hpp \
+    descriptors/multi_generator.hpp \
     io/compute_descriptors.hpp \
-    io/ordered_push_back.hpp
+    io/ordered_push_back.hpp \
+    io/compute_stats.hpp \
+    io/descriptor_cache.hpp \
+    util/latency_histogram.hpp \
+    util/hash.hpp \
+    io/image_loader.hpp
@@ -9,12 +9,15 @@ the terms of the BSD license (see the LICENSE file).
 #include <QDateTime>
 #include <QTime>
 
+#include <cstdio>
 #include <iostream>
 #include <queue>
+#include <algorithm>
 #include <stdexcept>
 
 #include <boost/thread.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <io/property_writer.hpp>
 #include <io/cmdline.hpp>
@@ -23,13 +26,60 @@ the terms of the BSD license (see the LICENSE file).
 #include <util/progress.hpp>
 #include <util/types.hpp>
 #include <descriptors/generator.hpp>
+#include <descriptors/multi_generator.hpp>
+#include <descriptors/filter_bank_cache.hpp>
 
 
 
 using namespace imdb;
 
 
-void progress_observer(const ComputeDescriptors& cd)
+// writes the metrics to a temporary file first such that readers never see a partially written file
+void write_metrics(const ComputeDescriptors& cd, const std::string& filename)
+{
+    ptree metrics;
+    cd.metrics(metrics);
+
+    std::string tmpname = filename + ".tmp";
+    try
+    {
+        boost::property_tree::write_json(tmpname, metrics);
+        if (std::rename(tmpname.c_str(), filename.c_str()) != 0) throw std::runtime_error("cannot rename " + tmpname);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "compute_descriptors: failed to write metrics to " << filename << ": " << e.what() << std::endl;
+    }
+}
+
+void print_report(const ComputeDescriptors& cd)
+{
+    std::cout << "time per stage (ms): " << std::endl;
+    std::cout << " stage      count        total s      mean      p50      p90      p99      max" << std::endl;
+    for (int s = 0; s < NumComputeStages; s++)
+    {
+        LatencyHistogram h = cd.stats().stage(static_cast<ComputeStage>(s));
+        if (h.count() == 0) continue;
+
+        std::printf(" %-8s %9llu %14.1f %9.2f %8.2f %8.2f %8.2f %8.2f\n", stage_name(static_cast<ComputeStage>(s)),
+                    static_cast<unsigned long long>(h.count()), h.sum() * 1e-6, h.mean() * 1e-3,
+                    h.quantile(0.5) * 1e-3, h.quantile(0.9) * 1e-3, h.quantile(0.99) * 1e-3, h.max() * 1e-3);
+    }
+    std::fflush(stdout);
+
+    uint64_t hits = cd.stats().cache_hits();
+    uint64_t misses = cd.stats().cache_misses();
+    if (hits + misses > 0) std::cout << "cache: " << hits << " hits, " << misses << " misses" << std::endl;
+
+    std::vector<ComputeStats::file_time_t> slowest = cd.stats().slowest();
+    if (!slowest.empty()) std::cout << "slowest files (ms for read, decode and compute):" << std::endl;
+    for (size_t i = 0; i < slowest.size(); i++)
+    {
+        std::cout << " " << slowest[i].first / 1000 << "\t" << slowest[i].second << "\t" << cd.files().get_filename(slowest[i].second) << std::endl;
+    }
+}
+
+void progress_observer(const ComputeDescriptors& cd, const std::string& metrics_file)
 {
     size_t lastindex = 0;
     int running_sum_time = 0;
@@ -82,6 +132,8 @@ void progress_observer(const ComputeDescriptors& cd)
 
         std::cout << "            \r" << std::flush;
 
+        if (!metrics_file.empty()) write_metrics(cd, metrics_file);
+
         lasttime.start();
         firstrun = false;
         lastindex = index;
@@ -108,12 +160,27 @@ class command_compute : public Command
 public:
 
     command_compute()
-        : Command("compute <generator> [options]")
+        : Command("compute <generator>[:<label>] [<generator>[:<label>] ...] [options]")
         , _co_rootdir   ("rootdir"          , "r", "root directory of data descriptors are computed from [required]")
         , _co_filelist  ("filelist"         , "f", "file that contains filenames of data (images/models) [required]")
         , _co_output    ("output"           , "o", "output prefix [required]")
-        , _co_params    ("parameters"       , "p", "parameters for generator construction [optional] (default: params defined in generator)")
+        , _co_params    ("parameters"       , "p", "parameters for generator construction as key=value, use <label>:key=value to address a single one of several generators [optional] (default: params defined in generator)")
         , _co_numthreads("numthreads"       , "t", "number of threads for parallel computation [optional] (default: number of processors)")
+        , _co_decodethreads("decodethreads" , "d", "number of separate threads that load and decode images [optional] (default: 0, done by the computation threads)")
+        , _co_writethreads("writethreads"   , "w", "number of separate threads that pass results to the output files [optional] (default: 0, done by the computation threads)")
+        , _co_codec     ("codec"            , "c", "write block-compressed output files using codec {none,shuffle,zlib} [optional] (default: uncompressed)")
+        , _co_shardsize ("shardsize"        , "s", "split output files into shards of at most this many elements [optional] (default: no sharding)")
+        , _co_checkpoint("checkpoint"       , "k", "make output files resumable every n elements, each checkpoint flushes the outputs while holding back results and appends the offsets of the last n elements to <output>.checkpoint [optional] (default: 10000, 0 disables checkpoints)")
+        , _co_resume    ("resume"           , "R", "continue a previous computation after its last checkpoint, requires the same options [optional]")
+        , _co_maxbuffered("maxbuffered"     , "b", "maximum number of results held back until all preceding results are written [optional] (default: 1000, 0 means unbounded)")
+        , _co_outoforder("outoforder"       , "u", "write results immediately in the order they are computed, not supported with --shardsize [optional]")
+        , _co_metrics   ("metrics"          , "m", "periodically write throughput, queue depths and per-stage timing to this JSON file [optional]")
+        , _co_slowest   ("slowest"          , "n", "number of slowest files listed at the end and in the metrics [optional] (default: 10)")
+        , _co_cache     ("cache"            , "C", "directory of a descriptor cache, files with cached results are not recomputed [optional]")
+        , _co_cachekey  ("cachekey"         , "K", "identify cached files by {stat,content}: name, size and modification time, or a hash of the content [optional] (default: stat)")
+        , _co_shard     ("shard"            , "S", "only process shard i of n of the filelist, given as i/n with 0 <= i < n, see merge_properties [optional] (default: all files)")
+        , _co_strided   ("strided"          , "T", "shards contain every n-th file instead of a contiguous range of the filelist [optional]")
+        , _co_filtercache("filtercache"     , "F", "directory in which the filter banks of galif and gist are stored and reused by later runs [optional] (default: none)")
 
     {
         add(_co_rootdir);
@@ -121,6 +188,21 @@ public:
         add(_co_output);
         add(_co_params);
         add(_co_numthreads);
+        add(_co_decodethreads);
+        add(_co_writethreads);
+        add(_co_codec);
+        add(_co_shardsize);
+        add(_co_checkpoint);
+        add(_co_resume);
+        add(_co_maxbuffered);
+        add(_co_outoforder);
+        add(_co_metrics);
+        add(_co_slowest);
+        add(_co_cache);
+        add(_co_cachekey);
+        add(_co_shard);
+        add(_co_strided);
+        add(_co_filtercache);
     }
 
 
@@ -134,12 +216,34 @@ public:
 
         warn_for_unknown_option(args);
 
-        std::string in_generator(args[0]);
+        // all arguments up to the first option name a generator, optionally followed by a label. With
+        // several generators, all are run on each decoded image and their output files are named
+        // <output><label>_<property>, the label defaults to the generator name
+        std::vector<std::string> in_generators;
+        std::vector<std::string> in_labels;
+        for (size_t i = 0; i < args.size() && !is_short_option(args[i]) && !is_long_option(args[i]); i++)
+        {
+            std::vector<std::string> gl;
+            boost::algorithm::split(gl, args[i], boost::algorithm::is_any_of(":"));
 
-        if (!Generator::generators().count(in_generator))
+            if (!Generator::generators().count(gl[0]))
+            {
+                std::cerr << "compute_descriptors: no generator named " << gl[0] << std::endl;
+                print_available_generators();
+                return false;
+            }
+            if (gl.size() > 2 || std::count(in_labels.begin(), in_labels.end(), gl.back()))
+            {
+                std::cerr << "compute_descriptors: generators need distinct labels: " << args[i] << std::endl;
+                return false;
+            }
+            in_generators.push_back(gl[0]);
+            in_labels.push_back(gl.back());
+        }
+
+        if (in_generators.empty())
         {
-            std::cerr << "compute_descriptors: no generator named " << in_generator << std::endl;
-            print_available_generators();
+            print();
             return false;
         }
 
@@ -162,6 +266,20 @@ public:
             }
         }
         std::cout << "compute_descriptors: using " << in_numthreads << " threads" << std::endl;
+
+        // optional separate stages for decoding images and writing results, these are
+        // mostly waiting for I/O and therefore do not count against the threads above
+        int in_decodethreads = 0;
+        int in_writethreads = 0;
+        _co_decodethreads.parse_single<int>(args, in_decodethreads);
+        _co_writethreads.parse_single<int>(args, in_writethreads);
+        if (in_decodethreads < 0 || in_writethreads < 0) {
+            std::cout << "compute_descriptors: number of decode/write threads should be >= 0, using default" << std::endl;
+            in_decodethreads = std::max(in_decodethreads, 0);
+            in_writethreads = std::max(in_writethreads, 0);
+        }
+        if (in_decodethreads > 0) std::cout << "compute_descriptors: using " << in_decodethreads << " decode threads" << std::endl;
+        if (in_writethreads > 0) std::cout << "compute_descriptors: using " << in_writethreads << " write threads" << std::endl;
         // ------------------------------------------------------------------------------------
 
         if (!_co_rootdir.parse_single<std::string>(args, in_rootdir)
@@ -173,20 +291,105 @@ public:
 
         _co_params.parse_multiple<std::string>(args, in_params);
 
+        std::string in_codec;
+        _co_codec.parse_single<std::string>(args, in_codec);
+
+        index_t in_shardsize = 0;
+        _co_shardsize.parse_single<index_t>(args, in_shardsize);
+
+        // checkpoints are incremental, their total cost is proportional to the number of elements and independent
+        // of the interval except for the flushes, which stall the computation threads briefly
+        size_t in_checkpoint = 10000;
+        _co_checkpoint.parse_single<size_t>(args, in_checkpoint);
+
+        bool in_resume = _co_resume.is_set(args);
+
+        size_t in_maxbuffered = 1000;
+        _co_maxbuffered.parse_single<size_t>(args, in_maxbuffered);
 
-        ptree params;
-        params.put("generator.name", in_generator);
+        std::string in_metrics;
+        _co_metrics.parse_single<std::string>(args, in_metrics);
+
+        size_t in_slowest = 10;
+        _co_slowest.parse_single<size_t>(args, in_slowest);
+
+        std::string in_cache;
+        _co_cache.parse_single<std::string>(args, in_cache);
+
+        std::string in_cachekey = "stat";
+        _co_cachekey.parse_single<std::string>(args, in_cachekey);
+        if (in_cachekey != "stat" && in_cachekey != "content")
+        {
+            std::cerr << "compute_descriptors: unknown cache key " << in_cachekey << ", use stat or content" << std::endl;
+            return false;
+        }
+
+        // shard i/n, such that several machines sharing the storage can work on the same filelist
+        size_t in_shard = 0;
+        size_t in_numshards = 1;
+        std::string in_shardspec;
+        if (_co_shard.parse_single<std::string>(args, in_shardspec))
+        {
+            std::vector<std::string> sn;
+            boost::algorithm::split(sn, in_shardspec, boost::algorithm::is_any_of("/"));
+            try
+            {
+                if (sn.size() != 2) throw boost::bad_lexical_cast();
+                in_shard = boost::lexical_cast<size_t>(sn[0]);
+                in_numshards = boost::lexical_cast<size_t>(sn[1]);
+            }
+            catch (const boost::bad_lexical_cast&)
+            {
+                in_numshards = 0;
+            }
+            if (in_numshards == 0 || in_shard >= in_numshards)
+            {
+                std::cerr << "compute_descriptors: cannot parse shard " << in_shardspec << ", expected i/n with 0 <= i < n" << std::endl;
+                return false;
+            }
+        }
+        bool in_strided = _co_strided.is_set(args);
+
+        std::string in_filtercache;
+        _co_filtercache.parse_single<std::string>(args, in_filtercache);
+
+        WriteMode in_writemode = _co_outoforder.is_set(args) ? WriteOutOfOrder : WriteInOrder;
+        if (in_writemode == WriteOutOfOrder && in_shardsize > 0)
+        {
+            std::cerr << "compute_descriptors: --outoforder cannot be combined with --shardsize" << std::endl;
+            return false;
+        }
+
+
+        std::vector<ptree> params(in_generators.size());
+        for (size_t k = 0; k < in_generators.size(); k++)
+        {
+            params[k].put("generator.name", in_generators[k]);
+        }
         for (size_t i = 0; i < in_params.size(); i++)
         {
+            // parameters without a label apply to all generators
+            std::string label;
+            std::string param = in_params[i];
+            size_t colon = param.find(':');
+            if (colon != std::string::npos && colon < param.find('='))
+            {
+                label = param.substr(0, colon);
+                param = param.substr(colon + 1);
+            }
+
             std::vector<std::string> pv;
-            boost::algorithm::split(pv, in_params[i], boost::algorithm::is_any_of("="));
+            boost::algorithm::split(pv, param, boost::algorithm::is_any_of("="));
 
-            if (pv.size() != 1 && pv.size() != 2)
+            if ((pv.size() != 1 && pv.size() != 2) || (!label.empty() && !std::count(in_labels.begin(), in_labels.end(), label)))
             {
                 std::cerr << "compute_descriptors: cannot parse descriptor parameter: " << in_params[i] << std::endl;
                 return false;
             }
-            params.put(pv[0], (pv.size() == 2) ? pv[1] : "");
+            for (size_t k = 0; k < in_generators.size(); k++)
+            {
+                if (label.empty() || label == in_labels[k]) params[k].put(pv[0], (pv.size() == 2) ? pv[1] : "");
+            }
         }
 
         FileList files;
@@ -212,13 +415,31 @@ public:
             }
         }
 
+        if (in_numshards > 1)
+        {
+            size_t total = files.size();
+            files.select_shard(in_shard, in_numshards, in_strided);
+            std::cout << "compute_descriptors: computing shard " << in_shard << "/" << in_numshards << " (" << files.size() << " of " << total << " files"
+                      << (in_strided ? ", strided" : "") << ")" << std::endl;
+        }
+
+        // the generators get their filter banks from the cache
+        FilterBankCache::set_directory(in_filtercache);
+
         // Create generator. Typical failure case for this
         // is that the JSON parameters contains an unregistered
         // name for a Generator/ImageSampler
         boost::shared_ptr<Generator> generator;
+        MultiGenerator::generators_t generators;
         try
         {
-            generator = Generator::from_parameters(params);
+            for (size_t k = 0; k < in_generators.size(); k++)
+            {
+                generators.push_back(std::make_pair(in_labels[k] + "_", Generator::from_parameters(params[k])));
+            }
+
+            if (generators.size() == 1) generator = generators[0].second;
+            else generator.reset(new MultiGenerator(generators));
         }
         catch (const std::exception& e)
         {
@@ -228,6 +449,23 @@ public:
 
         // initialize a computing object
         ComputeDescriptors cd(generator, files);
+        cd.set_num_slowest(in_slowest);
+
+        if (!in_cache.empty())
+        {
+            try
+            {
+                DescriptorCache::KeyMode mode = (in_cachekey == "content") ? DescriptorCache::KeyContent : DescriptorCache::KeyStat;
+                boost::shared_ptr<DescriptorCache> cache(new DescriptorCache(in_cache, generator, mode));
+                std::cout << "compute_descriptors: using cache " << cache->path() << " (" << cache->size() << " entries)" << std::endl;
+                cd.set_cache(cache);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "compute_descriptors: failed to open cache: " << e.what() << std::endl;
+                return false;
+            }
+        }
 
         // add writers for properties offered by the generator
         PropertyWriters::properties_t& propertyWriters = generator->propertyWriters().get();
@@ -238,7 +476,14 @@ public:
             const std::string& name = cit->first;
             string filename = in_output + name;
 
-            try { cit->second->open(filename); }
+            try
+            {
+                cit->second->set_codec(in_codec);
+                cit->second->set_async(true);
+                cit->second->set_shard_limits(in_shardsize, 0);
+                if (in_resume) cit->second->open_append(filename);
+                else cit->second->open(filename);
+            }
             catch (const std::exception& e)
             {
                 std::cerr << "compute_descriptors: failed to open property writer on file " << filename << ": " << e.what() << std::endl;
@@ -248,15 +493,25 @@ public:
                 return false;
             }
 
-            cd.add_writer(name, cit->second);
+            cd.add_writer(name, cit->second, in_checkpoint, in_maxbuffered, in_writemode);
+        }
+
+        if (in_resume)
+        {
+            index_t resume_index = files.size();
+            for (cit = propertyWriters.begin(); cit != propertyWriters.end(); ++cit)
+            {
+                resume_index = std::min(resume_index, cit->second->size());
+            }
+            std::cout << "compute_descriptors: resuming at file " << resume_index << std::endl;
         }
 
         // start computing descriptors
         QDateTime time = QDateTime::currentDateTime();
 
-        boost::thread obs(progress_observer, boost::ref(cd));
+        boost::thread obs(progress_observer, boost::ref(cd), in_metrics);
 
-        bool okay = cd.start(in_numthreads);
+        bool okay = cd.start(in_numthreads, in_decodethreads, in_writethreads);
 
         int seconds = time.secsTo(QDateTime::currentDateTime());
         obs.join();
@@ -267,8 +522,20 @@ public:
         std::cout << "finished." << std::endl;
         std::cout << "duration: " << fmth << "h " << fmtm << "m " << fmts << "s" << " (" << seconds << " s)" << std::endl;
 
-        string filename = in_output + "parameters";
-        boost::property_tree::write_json(filename, generator->parameters());
+        print_report(cd);
+        if (!in_metrics.empty()) write_metrics(cd, in_metrics);
+
+        if (generators.size() == 1)
+        {
+            boost::property_tree::write_json(in_output + "parameters", generator->parameters());
+        }
+        else
+        {
+            for (size_t k = 0; k < generators.size(); k++)
+            {
+                boost::property_tree::write_json(in_output + generators[k].first + "parameters", generators[k].second->parameters());
+            }
+        }
 
 
         if (!okay)
@@ -286,6 +553,21 @@ private:
     CmdOption _co_output;
     CmdOption _co_params;
     CmdOption _co_numthreads;
+    CmdOption _co_decodethreads;
+    CmdOption _co_writethreads;
+    CmdOption _co_codec;
+    CmdOption _co_shardsize;
+    CmdOption _co_checkpoint;
+    CmdOption _co_resume;
+    CmdOption _co_maxbuffered;
+    CmdOption _co_outoforder;
+    CmdOption _co_metrics;
+    CmdOption _co_slowest;
+    CmdOption _co_cache;
+    CmdOption _co_cachekey;
+    CmdOption _co_shard;
+    CmdOption _co_strided;
+    CmdOption _co_filtercache;
 };
 
 class command_info : public Command
@@ -38,6 +38,7 @@ public:
         , _co_sigma("sigma"                  , "s", "sigma for gaussian weighting in fuzzy quantization [required (with 'fuzzy' quantization only)]")
         , _co_output("output"                , "o", "filename of the output file of histograms of visual words [required]")
         , _co_pyramidlevels("pyramidlevels"  , "l", "number of spatial pyramid levels [optional, default 1]")
+        , _co_codec("codec"                  , "c", "write a block-compressed output file using codec {none,shuffle,zlib} [optional, default uncompressed]")
     {
         add(_co_vocabulary);
         add(_co_descriptors);
@@ -46,6 +47,7 @@ public:
         add(_co_quantization);
         add(_co_sigma);
         add(_co_pyramidlevels);
+        add(_co_codec);
     }
 
 
@@ -109,12 +111,15 @@ public:
         // check for optional arguments
         _co_pyramidlevels.parse_single<size_t>(args, in_pyramidlevels);
 
+        string in_codec;
+        _co_codec.parse_single<string>(args, in_codec);
+
         // ----------------------------------------------
         // we now have parse all relevant commandline
         // parameters and are ready to compute....
         // ----------------------------------------------
 
-        vec_vec_f32_t vocabulary;
+        FeatureMatrix vocabulary;
 
         try
         {
@@ -130,7 +135,7 @@ public:
 
 
 
-        quantize_fn quantizer; // boost::function, see quantizer.hpp for typedef
+        quantize_matrix_fn quantizer; // boost::function, see quantizer.hpp for typedef
         bool normalizeHistvw;
 
         if (in_quantization == "fuzzy")
@@ -149,21 +154,28 @@ public:
 
 
         try {
-            PropertyWriterT<vec_f32_t> writer(in_output);
-            PropertyReaderT<vec_vec_f32_t> reader_desc(in_descriptors);
-            PropertyReaderT<vec_vec_f32_t> reader_pos(in_positions);
+            PropertyWriterT<vec_f32_t> writer(in_output, in_codec);
+            // local features are stored as vec_vec_f32_t, we read them into a RaggedMatrix
+            PropertyReaderT<RaggedMatrix> reader_desc(in_descriptors, PropertyAccessPositional);
+            PropertyReaderT<RaggedMatrix> reader_pos(in_positions, PropertyAccessPositional);
 
             assert(reader_desc.size() == reader_pos.size());
             std::cout << "compute_histvw: reader #entries=" << reader_desc.size() << std::endl;
 
+            // both files are read strictly in order, let the cursors read ahead in the background
+            PropertyCursorT<RaggedMatrix> cursor_desc(reader_desc);
+            PropertyCursorT<RaggedMatrix> cursor_pos(reader_pos);
+
             progress_output progress(10);
             for (index_t i = 0; i < reader_desc.size(); i++)
             {
-                vec_vec_f32_t samples(reader_desc[i]);
-                vec_vec_f32_t positions(reader_pos[i]);
+                RaggedMatrix samples;
+                RaggedMatrix positions;
+                cursor_desc.next(samples);
+                cursor_pos.next(positions);
 
-                // quantize all samples contained in the current vec_vec_f32_t in parallel, the
-                // result is again a vec_vec_f32_t which has the same size as the samples vector,
+                // quantize all samples contained in the current RaggedMatrix in parallel, the
+                // result is a vec_vec_f32_t which has the same size as the samples matrix,
                 // i.e. one quantized sample for each original sample.
                 vec_vec_f32_t quantized_samples;
                 quantize_samples_parallel(samples, vocabulary, quantized_samples, quantizer);
@@ -208,6 +220,7 @@ private:
     CmdOption _co_sigma;
     CmdOption _co_output;
     CmdOption _co_pyramidlevels;
+    CmdOption _co_codec;
 };
 
 
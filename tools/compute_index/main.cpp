@@ -76,7 +76,9 @@ public:
 
 
         try {
-            PropertyReaderT<vec_f32_t> reader(in_histvw);
+            // the histograms are added straight from the mapped file, i.e.
+            // without deserializing each of them into a vec_f32_t first
+            PropertyReaderT<vec_f32_t> reader(in_histvw, PropertyAccessMapped);
 
             std::cout << "compute_index: histvw file contains a total of " << reader.size() << " histograms." << std::endl;
 
@@ -87,9 +89,20 @@ public:
             InvertedIndex index(vocabSize);
 
             progress_output progress;
+            vec_f32_t decoded;
             for (index_t i = 0; i < reader.size(); i++)
             {
-                index.addHistogram(reader[i]);
+                // block-compressed files cannot be viewed in place
+                if (reader.compressed())
+                {
+                    reader.get(decoded, i);
+                    index.addHistogram(decoded);
+                }
+                else
+                {
+                    PropertyReaderT<vec_f32_t>::views_t::value_type histogram = reader.view(i);
+                    index.addHistogram(histogram.begin(), histogram.size());
+                }
                 progress(i, reader.size(), "compute_index progress: ");
             }
 
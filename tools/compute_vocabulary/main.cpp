@@ -12,6 +12,7 @@ the terms of the BSD license (see the LICENSE file).
 
 #include <util/types.hpp>
 #include <util/kmeans.hpp>
+#include <util/feature_matrix.hpp>
 #include <io/property_reader.hpp>
 #include <io/property_writer.hpp>
 #include <io/cmdline.hpp>
@@ -20,13 +21,21 @@ the terms of the BSD license (see the LICENSE file).
 
 using namespace imdb;
 
+// callback of PropertyReaderT::get_many() in sampleWords(), copies the sampled local features of the k-th requested feature
+void addSamples(const std::vector<vector<int> >& sample_ids, imdb::FeatureMatrix& data, size_t k, vec_vec_f32_t& feature)
+{
+    for (size_t i = 0; i < sample_ids[k].size(); i++) {
+        data.push_back(feature[sample_ids[k][i]]);
+    }
+}
+
 // We assume that we have a descriptor file that contains (in each element) a vec_vec_f32_t, i.e.
 // a vector of local descriptors with each local descriptor being a vec_f32_t. Note that the
 // descriptorfile does not give us an easy way to determine how many local features each element
 // contains, we would need to read in each element to determine this. Therefore, we require to
 // pass in an additional "size file", that holds the exact number of local features stored for each entry
 // in the descriptor file.
-void sampleWords(const std::string& descriptorFile, const std::string& sizeFile, size_t numSamples, imdb::vec_vec_f32_t& data)
+void sampleWords(const std::string& descriptorFile, const std::string& sizeFile, size_t numSamples, imdb::FeatureMatrix& data)
 {
     std::vector<int32_t> sizes;
 
@@ -64,35 +73,31 @@ void sampleWords(const std::string& descriptorFile, const std::string& sizeFile,
         map_featureid_sampleids[feature_id].push_back(sample_id);
     }
 
+    std::vector<index_t> feature_ids;
+    std::vector<vector<int> > sample_ids;
+    map<int, vector<int> >::const_iterator cit;
+    for (cit = map_featureid_sampleids.begin(); cit != map_featureid_sampleids.end(); ++cit) {
+        feature_ids.push_back(cit->first);
+        sample_ids.push_back(cit->second);
+    }
 
-    std::cout << "compute_vocabulary: extracting samples from descriptor file" << std::endl;
-
-
-    PropertyReaderT<vec_vec_f32_t> reader(descriptorFile);
 
-    std::cout << "compute_vocabulary: reading " << (map_featureid_sampleids.size() / static_cast<float>(reader.size()))*100 << "% of all features to gather desired number of samples."  << std::endl;
+    std::cout << "compute_vocabulary: extracting samples from descriptor file" << std::endl;
 
-    map<int, vector<int> >::const_iterator cit;
 
-    for (cit = map_featureid_sampleids.begin(); cit != map_featureid_sampleids.end(); ++cit) {
+    PropertyReaderT<vec_vec_f32_t> reader(descriptorFile, PropertyAccessPositional);
 
-        int feature_id = cit->first;
-        vec_vec_f32_t feature;
-        reader.get(feature, feature_id);
+    std::cout << "compute_vocabulary: reading " << (feature_ids.size() / static_cast<float>(reader.size()))*100 << "% of all features to gather desired number of samples."  << std::endl;
 
-        const vector<int>& sample_ids = cit->second;
-        for (size_t i = 0; i < sample_ids.size(); i++) {
-            int sample_id = sample_ids[i];
-            data.push_back(feature[sample_id]);
-        }
-    }
+    // get_many() merges the requested features into large sequential reads
+    reader.get_many(feature_ids, boost::bind(&addSamples, boost::cref(sample_ids), boost::ref(data), _1, _2));
 
     assert(data.size() == numSamples);
 
     std::cout << "compute_vocabulary: done, data contains " << data.size() << " samples." << std::endl;
 }
 
-void readAllWords(const std::string& descriptorFile, imdb::vec_vec_f32_t& data)
+void readAllWords(const std::string& descriptorFile, imdb::FeatureMatrix& data)
 {
     std::cout << "compute_vocabulary: extracting samples from descriptor file..." << std::endl;
 
@@ -128,6 +133,7 @@ public:
         , _co_numthreads("numthreads"       , "t", "number of threads for parallel computation (default: number of processors) [optional]")
         , _co_maxiter   ("maxiter"          , "i", "kmeans stopping criterion: maximum number of iterations (default: 20) [optional]")
         , _co_minchangesfraction("minchangesfraction" , "m", "kmeans stopping criterion: number of changes (fraction of total samples) (default: 0.01) [optional]")
+        , _co_dense     ("dense"            , "D", "write the vocabulary as a dense property file, which compute_histvw and image_search read faster but PropertyReaderT cannot read [optional]")
     {
         add(_co_descfile);
         add(_co_sizefile);
@@ -137,6 +143,7 @@ public:
         add(_co_numthreads);
         add(_co_maxiter);
         add(_co_minchangesfraction);
+        add(_co_dense);
     }
 
 
@@ -197,7 +204,7 @@ public:
             return false;
         }
 
-        vec_vec_f32_t samples;
+        FeatureMatrix samples;
         if (has_sizefile && has_numsamples)
         {
             try { sampleWords(in_descfile, in_sizefile, in_numsamples, samples); }
@@ -220,14 +227,22 @@ public:
         std::cout << "compute_vocabulary: clustering" << std::endl;
 
         // cluster the data
-        vec_vec_f32_t centers;
-        typedef kmeans<vec_vec_f32_t, l2norm_squared<vec_f32_t> > cluster_fn;
+        typedef kmeans<FeatureMatrix, l2norm_squared<vec_f32_t> > cluster_fn;
         cluster_fn clusterfn(samples, in_numclusters);
         clusterfn.run(in_maxiter, in_minchangesfraction);
-        centers = clusterfn.centers();
 
-        // write the resulting cluster centers
-        try { write_property(centers, in_outputfile); }
+        // write the resulting cluster centers, as a dense property file only on request such that
+        // existing readers of vec_f32_t property files keep working
+        try
+        {
+            if (_co_dense.is_set(args))
+            {
+                FeatureMatrix centers;
+                for (size_t i = 0; i < clusterfn.centers().size(); i++) centers.push_back(clusterfn.centers()[i]);
+                write_property(centers, in_outputfile);
+            }
+            else write_property(clusterfn.centers(), in_outputfile);
+        }
         catch (const std::exception& e)
         {
             std::cerr << "compute_vocabulary: failed to write vocabulary: " << e.what() << std::endl;
@@ -249,6 +264,7 @@ private:
     CmdOption _co_numthreads;
     CmdOption _co_maxiter;
     CmdOption _co_minchangesfraction;
+    CmdOption _co_dense;
 };
 
 int main(int argc, char **argv)
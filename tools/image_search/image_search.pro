@@ -16,6 +16,9 @@ descriptors/generator.cpp \
 descriptors/shog.cpp \
 descriptors/galif.cpp \
 descriptors/utilities.cpp \
+descriptors/simd_kernels.cpp \
+descriptors/tile_aggregator.cpp \
+descriptors/filter_bank_cache.cpp \
 descriptors/image_sampler.cpp \
 io/filelist.cpp \
 util/quantizer.cpp
@@ -18,6 +18,7 @@ the terms of the BSD license (see the LICENSE file).
 #include <io/cmdline.hpp>
 #include <io/filelist.hpp>
 #include <descriptors/generator.hpp>
+#include <descriptors/filter_bank_cache.hpp>
 #include <search/linear_search.hpp>
 #include <search/bof_search_manager.hpp>
 #include <search/linear_search_manager.hpp>
@@ -49,6 +50,7 @@ public:
         , _co_generator_name("generatorname"  , "g", "name of generator [optional, if given, we will use generator's default parameters and ignore --generatorptree]")
         , _co_generator_ptree("generatorptree", "p", "filename of the JSON file containing generator name and parameters [optional, if not provided, generator's default values are used']")
         , _co_num_results  ("numresults"      , "n", "number of results to search for [optional, if not provided all distances get computed]")
+        , _co_filtercache  ("filtercache"     , "F", "directory in which the generator's filter bank is stored, later queries map it instead of building it [optional]")
 
     {
         add(_co_query_image);
@@ -59,6 +61,7 @@ public:
         add(_co_generator_ptree);
         add(_co_num_results);
         add(_co_generator_name);
+        add(_co_filtercache);
     }
 
 
@@ -79,6 +82,7 @@ public:
         string in_generatorptree;
         string in_generatorname;
         string in_vocabulary;
+        string in_filtercache;
 
         // this default value will make the search managers search
         // for all images if the user does not provide a value
@@ -129,6 +133,10 @@ public:
         // try to parse the optional num_results parameter
         _co_num_results.parse_single<size_t>(args, in_numresults);
 
+        // building the filter bank of galif takes much longer than the query itself,
+        // with a cache directory it is built once and mapped by later queries
+        if (_co_filtercache.parse_single<string>(args, in_filtercache)) FilterBankCache::set_directory(in_filtercache);
+
         // -----------------------------------------------------------------
         // create the generator; we have the following rule:
         // a) if the user provides a generator name, we use this and ignore an additional generator ptree
@@ -180,14 +188,14 @@ public:
             }
 
 
-            vec_vec_f32_t vocabulary;
+            FeatureMatrix vocabulary;
             read_property(vocabulary, in_vocabulary);
 
             // quantize
-            quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
+            quantize_matrix_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
             vec_vec_f32_t quantized_samples;
 
-            const vec_vec_f32_t& samples = boost::any_cast<vec_vec_f32_t>(data["features"]);
+            const RaggedMatrix& samples = boost::any_cast<const RaggedMatrix&>(data["features"]);
             quantize_samples_parallel(samples, vocabulary, quantized_samples, quantizer);
 
             vec_f32_t histvw;
@@ -251,6 +259,7 @@ private:
     CmdOption _co_generator_name;
     CmdOption _co_generator_ptree;
     CmdOption _co_num_results;
+    CmdOption _co_filtercache;
 };
 
 
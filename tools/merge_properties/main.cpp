@@ -0,0 +1,316 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <iostream>
+#include <fstream>
+
+#include <util/types.hpp>
+#include <util/progress.hpp>
+#include <util/reduced_precision.hpp>
+
+#include <io/cmdline.hpp>
+#include <io/dense_header.hpp>
+#include <io/property_reader.hpp>
+#include <io/property_writer.hpp>
+
+
+
+// ------------------------------------------------------------
+// General usage
+//
+//    merge the property files computed by several instances of
+//    compute_descriptors --shard i/n back into a single file
+//    in the order of the complete filelist:
+//
+//    merge_properties shard0_features shard1_features ... -o features
+//
+// The shard files must be passed in shard order 0 ... n-1. Shards that
+// have been computed with --strided are interleaved (pass --strided here
+// as well), otherwise they are concatenated. Elements are streamed from
+// the shards to the output one at a time, so the files may be larger than
+// main memory. Sharded (manifest) and dense property files are supported
+// as input, dense input files give a dense output file.
+// ------------------------------------------------------------
+
+using namespace imdb;
+
+
+// sequential access to all elements of a regular or sharded property file
+template <class T>
+class PropertyInput : boost::noncopyable
+{
+public:
+
+    typedef T value_type;
+
+    PropertyInput(const std::string& filename) : _part(0)
+    {
+        if (is_sharded_property_file(filename)) _sharded.reset(new ShardedPropertyReaderT<T>(filename, PropertyAccessPositional));
+        else _reader.reset(new PropertyReaderT<T>(filename, PropertyAccessPositional));
+    }
+
+    index_t size() const
+    {
+        return _sharded ? _sharded->size() : _reader->size();
+    }
+
+    bool next(T& e)
+    {
+        for (;;)
+        {
+            if (!_cursor)
+            {
+                const PropertyReaderT<T>* reader = part(_part);
+                if (!reader) return false;
+                _cursor.reset(new PropertyCursorT<T>(*reader, 0, reader->size(), 4 << 20));
+            }
+
+            if (_cursor->next(e)) return true;
+
+            _cursor.reset();
+            _part++;
+        }
+    }
+
+private:
+
+    // the shards of a sharded file are read one after the other
+    const PropertyReaderT<T>* part(std::size_t i) const
+    {
+        if (_sharded) return i < _sharded->num_shards() ? &_sharded->shard(i) : 0;
+        return i == 0 ? _reader.get() : 0;
+    }
+
+    shared_ptr<PropertyReaderT<T> >        _reader;
+    shared_ptr<ShardedPropertyReaderT<T> > _sharded;
+    shared_ptr<PropertyCursorT<T> >        _cursor;
+    std::size_t                            _part;
+};
+
+
+// sequential access to the rows of a dense property file
+class DenseInput : boost::noncopyable
+{
+public:
+
+    typedef vec_f32_t value_type;
+
+    DenseInput(const std::string& filename) : _ifs(filename.c_str(), std::ifstream::binary), _row(0)
+    {
+        if (!_ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+        _header.read(_ifs);
+        _ifs.seekg(dense_header::size());
+        _padding.resize(_header.stride - _header.cols);
+    }
+
+    index_t size() const
+    {
+        return _header.rows;
+    }
+
+    bool next(vec_f32_t& e)
+    {
+        if (_row == _header.rows) return false;
+
+        e.resize(_header.cols);
+        if (!e.empty()) _ifs.read(reinterpret_cast<char*>(&e[0]), e.size() * sizeof(float));
+        if (!_padding.empty()) _ifs.read(reinterpret_cast<char*>(&_padding[0]), _padding.size() * sizeof(float));
+        if (!_ifs.good()) throw std::runtime_error("error while reading dense property file");
+
+        _row++;
+        return true;
+    }
+
+private:
+
+    std::ifstream  _ifs;
+    dense_header   _header;
+    vec_f32_t      _padding;
+    int64_t        _row;
+};
+
+
+// Copies the elements of the inputs in global order to writer. With strided shards, global
+// element j is element j / n of shard j % n, otherwise the shards are simply concatenated.
+template <class input_t>
+void merge(const std::vector<std::string>& filenames, PropertyWriter& writer, bool strided)
+{
+    typedef typename input_t::value_type T;
+
+    std::vector<shared_ptr<input_t> > inputs;
+    index_t total = 0;
+    for (std::size_t s = 0; s < filenames.size(); s++)
+    {
+        inputs.push_back(shared_ptr<input_t>(new input_t(filenames[s])));
+        total += inputs.back()->size();
+    }
+
+    // shard s of n strided shards contains the elements s, s + n, s + 2n, ...
+    index_t n = inputs.size();
+    if (strided)
+    {
+        for (index_t s = 0; s < n; s++)
+        {
+            if (inputs[s]->size() != (total + n - 1 - s) / n)
+            {
+                throw std::runtime_error("the size of " + filenames[s] + " does not match a strided shard, are the shards passed in order?");
+            }
+        }
+    }
+
+    // the writer takes a boost::any, the element is swapped in and out of it to avoid copies
+    boost::any holder = T();
+    T& e = boost::any_cast<T&>(holder);
+
+    progress_output progress;
+    std::size_t s = 0;
+    for (index_t j = 0; j < total; j++)
+    {
+        // contiguous shards: continue with the next shard once the current one is exhausted
+        bool okay;
+        if (strided) okay = inputs[j % n]->next(e);
+        else while (!(okay = inputs[s]->next(e)) && s + 1 < inputs.size()) s++;
+
+        if (!okay) throw std::runtime_error("unexpected end of input");
+
+        if (!writer.push_back(holder)) throw std::runtime_error("failed to write element");
+        progress(j, total, "merge_properties: ");
+    }
+}
+
+
+class command_merge : public Command
+{
+public:
+
+    command_merge()
+        : Command("merge_properties <shard file 0> <shard file 1> ... [options]")
+        , _co_output    ("output"       , "o", "merged property file [required]")
+        , _co_strided   ("strided"      , "T", "the shards have been computed with compute_descriptors --strided, interleave instead of concatenating them [optional]")
+        , _co_codec     ("codec"        , "c", "write a block-compressed output file using codec {none,shuffle,zlib} [optional] (default: uncompressed)")
+    {
+        add(_co_output);
+        add(_co_strided);
+        add(_co_codec);
+    }
+
+    bool run(const std::vector<std::string>& args)
+    {
+        warn_for_unknown_option(args);
+
+        // all arguments up to the first option are shard files
+        std::vector<std::string> in_files;
+        for (size_t i = 0; i < args.size() && !is_short_option(args[i]) && !is_long_option(args[i]); i++)
+        {
+            in_files.push_back(args[i]);
+        }
+
+        std::string in_output;
+        if (in_files.empty() || !_co_output.parse_single<std::string>(args, in_output))
+        {
+            print();
+            return false;
+        }
+
+        std::string in_codec;
+        _co_codec.parse_single<std::string>(args, in_codec);
+
+        bool in_strided = _co_strided.is_set(args);
+
+        // all shards must store the same type, dense files can only be merged with dense files
+        std::string type_name;
+        bool dense = false;
+        try
+        {
+            for (size_t i = 0; i < in_files.size(); i++)
+            {
+                std::string t = property_type_name(in_files[i]);
+                bool d = is_dense_property_file(in_files[i]);
+                if (i == 0)
+                {
+                    type_name = t;
+                    dense = d;
+                }
+                else if (t != type_name || d != dense)
+                {
+                    std::cerr << "merge_properties: " << in_files[i] << " does not store the same type as " << in_files[0] << std::endl;
+                    return false;
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "merge_properties: " << e.what() << std::endl;
+            return false;
+        }
+
+        try
+        {
+            if (dense)
+            {
+                DensePropertyWriter writer;
+                writer.set_codec(in_codec);
+                writer.open(in_output);
+                merge<DenseInput>(in_files, writer, in_strided);
+                writer.close();
+            }
+            else if (type_name == nameof<vec_f32_t>())     merge_property<vec_f32_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<vec_vec_f32_t>()) merge_property<vec_vec_f32_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<vec_f16_t>())     merge_property<vec_f16_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<vec_q8_t>())      merge_property<vec_q8_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<vec_i32_t>())     merge_property<vec_i32_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<vec_u32_t>())     merge_property<vec_u32_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<int32_t>())       merge_property<int32_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<int64_t>())       merge_property<int64_t>(in_files, in_output, in_codec, in_strided);
+            else if (type_name == nameof<float>())         merge_property<float>(in_files, in_output, in_codec, in_strided);
+            else
+            {
+                std::cerr << "merge_properties: unsupported element type " << (type_name.empty() ? "(unknown)" : type_name) << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "merge_properties: failed to merge into " << in_output << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        std::cout << "merge_properties: merged " << in_files.size() << " shards into " << in_output << std::endl;
+        return true;
+    }
+
+private:
+
+    template <class T>
+    static void merge_property(const std::vector<std::string>& files, const std::string& output, const std::string& codec, bool strided)
+    {
+        PropertyWriterT<T> writer;
+        writer.set_codec(codec);
+        writer.set_async(true);
+        writer.open(output);
+        merge<PropertyInput<T> >(files, writer, strided);
+        writer.close();
+    }
+
+    CmdOption _co_output;
+    CmdOption _co_strided;
+    CmdOption _co_codec;
+};
+
+
+
+int main(int argc, char *argv[])
+{
+    if (argc <= 1)
+    {
+        command_merge().print();
+        return 1;
+    }
+
+    return command_merge().run(argv_to_strings(argc - 1, &argv[1])) ? 0 : 2;
+}
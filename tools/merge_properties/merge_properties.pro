@@ -0,0 +1,16 @@
+TARGET = merge_properties
+TEMPLATE = app
+include(../../common.pri)
+
+LIBS += -lboost_filesystem-mt -lboost_system-mt
+
+CONFIG += console
+
+SOURCES += main.cpp
+
+HEADERS += util/types.hpp \
+    util/progress.hpp \
+    io/property_reader.hpp \
+    io/property_writer.hpp \
+    io/dense_header.hpp \
+    io/cmdline.hpp
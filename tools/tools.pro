@@ -1,6 +1,7 @@
 TEMPLATE = subdirs
 SUBDIRS = generate_filelist \
 generate_mapping \
+merge_properties \
 compute_descriptors \
 compute_vocabulary \
 compute_histvw \
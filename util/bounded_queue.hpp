@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <deque>
+#include <cassert>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace imdb {
+
+/**
+ * @ingroup util
+ * @brief Thread-safe FIFO queue with a fixed capacity.
+ *
+ * push() blocks while the queue is full, pop() blocks while it is empty. This is what we use
+ * to hand over data between the stages of a producer/consumer setup: the capacity bounds the
+ * amount of memory held in flight and automatically throttles the faster side.
+ *
+ * close() signals that no more elements will be pushed. Consumers still receive all elements
+ * that are queued at that time, afterwards pop() returns false. Pushing into a closed queue
+ * returns false, which is how a consumer can make the producer stop early.
+ */
+template <class T>
+class bounded_queue : boost::noncopyable
+{
+    typedef boost::mutex                 mutex_t;
+    typedef boost::unique_lock<mutex_t>  locker_t;
+
+    public:
+
+    explicit bounded_queue(std::size_t capacity) : _capacity(capacity), _closed(false)
+    {
+        assert(_capacity > 0);
+    }
+
+    /// Appends e, blocks while the queue is full.
+    /// @return false if the queue has been closed, e has not been added then
+    bool push(const T& e)
+    {
+        locker_t locker(_mutex);
+        while (!_closed && _queue.size() >= _capacity) _not_full.wait(locker);
+        if (_closed) return false;
+
+        _queue.push_back(e);
+        _not_empty.notify_one();
+        return true;
+    }
+
+    /// Removes the first element and stores it in e, blocks while the queue is empty.
+    /// @return false if the queue has been closed and all elements have been consumed
+    bool pop(T& e)
+    {
+        locker_t locker(_mutex);
+        while (!_closed && _queue.empty()) _not_empty.wait(locker);
+        if (_queue.empty()) return false;
+
+        e = _queue.front();
+        _queue.pop_front();
+        _not_full.notify_one();
+        return true;
+    }
+
+    /// No more elements can be pushed after this call, wakes up all waiting threads.
+    void close()
+    {
+        locker_t locker(_mutex);
+        _closed = true;
+        _not_full.notify_all();
+        _not_empty.notify_all();
+    }
+
+    bool closed() const
+    {
+        locker_t locker(_mutex);
+        return _closed;
+    }
+
+    std::size_t size() const
+    {
+        locker_t locker(_mutex);
+        return _queue.size();
+    }
+
+    std::size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    private:
+
+    mutable mutex_t           _mutex;
+    boost::condition_variable _not_full;
+    boost::condition_variable _not_empty;
+    std::deque<T>             _queue;
+    std::size_t               _capacity;
+    bool                      _closed;
+};
+
+} // namespace imdb
+
+#endif // BOUNDED_QUEUE_HPP
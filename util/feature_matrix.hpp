@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef FEATURE_MATRIX_HPP
+#define FEATURE_MATRIX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/range/iterator_range.hpp>
+#include <boost/align/aligned_allocator.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup util
+ * @brief Dense, row-major matrix of float features with a fixed number of columns.
+ *
+ * This is the in-memory counterpart of the dense property file format (see DensePropertyWriter
+ * and read_property(FeatureMatrix&, const string&)). All rows live in a single contiguous buffer,
+ * each row starts at a 64-byte boundary (rows are zero-padded to stride() floats), i.e. loading
+ * millions of global descriptors costs a single allocation and SIMD kernels can operate on
+ * aligned, contiguous data.
+ *
+ * FeatureMatrix mimics a vector<vec_f32_t> closely enough to be used with kmeans, quantize_hard,
+ * quantize_fuzzy and linear_search: size() gives the number of rows and operator[] returns a
+ * lightweight row view. Note that value_type is vec_f32_t, i.e. the type a row is copied into
+ * when an owning sample is required (e.g. kmeans cluster centers), not the type of a row view.
+ */
+class FeatureMatrix
+{
+    public:
+
+    typedef vec_f32_t                           value_type;
+    typedef boost::iterator_range<const float*> const_row;
+    typedef boost::iterator_range<float*>       row;
+
+    /// alignment of each row in bytes
+    static const size_t alignment = 64;
+
+    FeatureMatrix() : _rows(0), _cols(0), _stride(0) {}
+
+    /// Creates a zero-filled matrix of the given size
+    FeatureMatrix(size_t rows, size_t cols) : _rows(0), _cols(0), _stride(0)
+    {
+        resize(rows, cols);
+    }
+
+    /// Resizes the matrix, all content is zero-filled. Changing the number of columns
+    /// of a non-empty matrix is not supported.
+    void resize(size_t rows, size_t cols)
+    {
+        if (_rows > 0 && cols != _cols) throw std::runtime_error("FeatureMatrix: cannot change the number of columns of a non-empty matrix");
+
+        _cols = cols;
+        _stride = aligned_stride(cols);
+        _rows = rows;
+        _data.resize(_rows * _stride, 0.0f);
+    }
+
+    /// Reserve memory for the given number of rows, requires that the number of columns is known.
+    void reserve(size_t rows, size_t cols)
+    {
+        if (_rows == 0)
+        {
+            _cols = cols;
+            _stride = aligned_stride(cols);
+        }
+        _data.reserve(rows * _stride);
+    }
+
+    void clear()
+    {
+        _data.clear();
+        _rows = 0;
+    }
+
+    /// Appends a row, the first row determines the number of columns if not yet known.
+    /// range_t can be any range of values convertible to float, e.g. vec_f32_t or const_row.
+    template <class range_t>
+    void push_back(const range_t& r)
+    {
+        size_t n = std::distance(r.begin(), r.end());
+
+        if (_rows == 0 && _data.empty())
+        {
+            _cols = n;
+            _stride = aligned_stride(n);
+        }
+
+        if (n != _cols) throw std::runtime_error("FeatureMatrix: all rows must have the same number of columns");
+
+        _data.resize((_rows + 1) * _stride, 0.0f);
+        std::copy(r.begin(), r.end(), _data.begin() + _rows * _stride);
+        _rows++;
+    }
+
+    const_row operator[] (size_t i) const
+    {
+        const float* p = &_data[0] + i * _stride;
+        return const_row(p, p + _cols);
+    }
+
+    row operator[] (size_t i)
+    {
+        float* p = &_data[0] + i * _stride;
+        return row(p, p + _cols);
+    }
+
+    /// Number of rows, named size() for compatibility with vector<vec_f32_t>
+    size_t size() const { return _rows; }
+    bool empty() const { return _rows == 0; }
+
+    size_t rows() const { return _rows; }
+    size_t cols() const { return _cols; }
+
+    /// Distance between the beginning of two successive rows, in floats
+    size_t stride() const { return _stride; }
+
+    const float* data() const { return _data.empty() ? 0 : &_data[0]; }
+    float* data() { return _data.empty() ? 0 : &_data[0]; }
+
+    /// Number of floats per row, padded such that each row starts at a 64-byte boundary
+    static size_t aligned_stride(size_t cols)
+    {
+        const size_t n = alignment / sizeof(float);
+        return (cols + n - 1) / n * n;
+    }
+
+    private:
+
+    typedef std::vector<float, boost::alignment::aligned_allocator<float, alignment> > storage_t;
+
+    size_t    _rows;
+    size_t    _cols;
+    size_t    _stride;
+    storage_t _data;
+};
+
+} // namespace imdb
+
+#endif // FEATURE_MATRIX_HPP
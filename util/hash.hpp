@@ -0,0 +1,37 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+namespace imdb {
+
+/**
+ * @ingroup util
+ * @brief 64-bit FNV-1a hash, pass the result of a previous call as h to hash data in pieces.
+ *
+ * Not a cryptographic hash, but good enough to tell files and parameter sets apart and
+ * cheap compared to reading or decoding them.
+ */
+inline uint64_t fnv1a(const char* data, std::size_t n, uint64_t h = 14695981039346656037ULL)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+} // namespace imdb
+
+#endif // HASH_HPP
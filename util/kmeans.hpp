@@ -22,9 +22,19 @@ the terms of the BSD license (see the LICENSE file).
 #include <QTime>
 
 #include "../search/distance.hpp"
+#include "reduced_precision.hpp"
 #include "kmeans_init.hpp"
 
 
+/**
+ * @brief Type of the cluster centers when clustering samples of type sample_t.
+ *
+ * Reduced precision samples are accumulated and stored in full precision.
+ */
+template <class sample_t> struct kmeans_center { typedef sample_t type; };
+template <> struct kmeans_center<imdb::vec_f16_t> { typedef imdb::vec_f32_t type; };
+template <> struct kmeans_center<imdb::vec_q8_t> { typedef imdb::vec_f32_t type; };
+
 
 /**
  * @brief Standard kmeans clustering
@@ -35,14 +45,14 @@ class kmeans
     typedef boost::mutex               mutex_t;
     typedef boost::lock_guard<mutex_t> locker_t;
 
-    typedef typename collection_t::value_type sample_t;
+    typedef typename kmeans_center<typename collection_t::value_type>::type sample_t;
 
     public:
 
     /**
      * @brief Standard k-means clustering given a distance function
      * @param collection Datastructure containing the samples to be clustered, typically a vector<vector<float> >, where the 'inner'
-     * vector<float> would be a single sample.
+     * vector<float> would be a single sample, or an imdb::FeatureMatrix. collection_t::value_type is used as the type of the centers.
      * @param numclusters Number of clusters to use.
      * @param initalgorithm Algorithm used to estimate the inital cluster centers
      * @param distfn Distance function used for comparing two samples.
@@ -61,7 +71,7 @@ class kmeans
             kmeans_init_random(initindices, collection, numclusters);
         }
 
-        for (std::size_t i = 0; i < initindices.size(); i++) _centers[i] = collection[initindices[i]];
+        for (std::size_t i = 0; i < initindices.size(); i++) assign(_centers[i], collection[initindices[i]]);
     }
 
     /**
@@ -167,7 +177,7 @@ std::cout << "handle invalid clusters: " << invalid.size() << std::endl;
                 // the farthest member of that cluster the
                 // new center
                 std::size_t c = std::distance(variance.begin(), std::max_element(variance.begin(), variance.end()));
-                _centers[current] = _collection[farthest[c]];
+                assign(_centers[current], _collection[farthest[c]]);
                 _clusters[farthest[c]] = current;
 
 std::cout << "reassign " << current << " to sample " << farthest[c] << " of cluster " << c << std::endl;
@@ -213,8 +223,8 @@ std::cout << "kmeans iterations: " << iteration << std::endl;
         for (std::size_t i = 0; i < _clusters.size(); i++) table[_clusters[i]].push_back(i);
     }
 
-    template <class T>
-    static void add_operation(T& lhs, const T& rhs)
+    template <class T, class U>
+    static void add_operation(T& lhs, const U& rhs)
     {
         for (std::size_t i = 0; i < lhs.size(); i++) lhs[i] += rhs[i];
     }
@@ -227,6 +237,13 @@ std::cout << "kmeans iterations: " << iteration << std::endl;
 
     private:
 
+    // copies a sample into a center, the sample can also be a row view of a FeatureMatrix
+    template <class U>
+    static void assign(sample_t& center, const U& sample)
+    {
+        center.assign(sample.begin(), sample.end());
+    }
+
     void distribute_samples(std::size_t& index, std::size_t& changes, mutex_t& mutex)
     {
         std::vector<double> dists(_centers.size());
@@ -243,7 +260,7 @@ std::cout << "kmeans iterations: " << iteration << std::endl;
             }
 
             // compute distance of current point to every center
-            std::transform(_centers.begin(), _centers.end(), dists.begin(), boost::bind(_distfn, boost::ref(_collection[i]), boost::arg<1>()));
+            for (std::size_t k = 0; k < _centers.size(); k++) dists[k] = _distfn(_collection[i], _centers[k]);
 
             // find the minimum distance, i.e. the nearest center
             std::size_t c = std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
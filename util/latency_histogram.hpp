@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cmath>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+namespace imdb {
+
+/**
+ * @ingroup util
+ * @brief Histogram of durations in microseconds with logarithmic (power of two) buckets.
+ *
+ * Adding a value costs a few instructions and the histogram has a fixed size, so it can be
+ * updated for every processed element. Quantiles are approximate: quantile() returns the
+ * upper bound of the bucket the quantile falls into, i.e. it is off by at most a factor of 2.
+ */
+class LatencyHistogram
+{
+    public:
+
+    /// bucket 0 holds 0us, bucket i > 0 holds [2^(i-1), 2^i) us, the last one everything above
+    static const int num_buckets = 40;
+
+    LatencyHistogram() : _count(0), _sum(0), _max(0)
+    {
+        std::fill(_buckets, _buckets + num_buckets, 0);
+    }
+
+    void add(uint64_t us)
+    {
+        _buckets[bucket(us)]++;
+        _count++;
+        _sum += us;
+        _max = std::max(_max, us);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (int i = 0; i < num_buckets; i++) _buckets[i] += other._buckets[i];
+        _count += other._count;
+        _sum += other._sum;
+        _max = std::max(_max, other._max);
+    }
+
+    uint64_t count() const { return _count; }
+    uint64_t sum() const { return _sum; }
+    uint64_t max() const { return _max; }
+    double mean() const { return _count > 0 ? static_cast<double>(_sum) / _count : 0.0; }
+
+    /// Approximate q-quantile, q in [0,1]
+    uint64_t quantile(double q) const
+    {
+        if (_count == 0) return 0;
+
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * _count)));
+        uint64_t seen = 0;
+        for (int i = 0; i < num_buckets; i++)
+        {
+            seen += _buckets[i];
+            if (seen >= rank) return std::min(_max, upper_bound(i));
+        }
+        return _max;
+    }
+
+    private:
+
+    static int bucket(uint64_t us)
+    {
+        int b = 0;
+        while (us > 0 && b < num_buckets - 1)
+        {
+            us >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    static uint64_t upper_bound(int b)
+    {
+        return b == 0 ? 0 : (static_cast<uint64_t>(1) << b) - 1;
+    }
+
+    uint64_t _buckets[num_buckets];
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _max;
+};
+
+} // namespace imdb
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -22,7 +22,50 @@ void quantize_samples_parallel(const vec_vec_f32_t& samples, const vec_vec_f32_t
     }
 }
 
-void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabularySize, vec_f32_t& histvw, bool normalize, const vec_vec_f32_t& positions, int res)
+void quantize_samples_parallel(const vec_vec_f32_t& samples, const FeatureMatrix& vocabulary, vec_vec_f32_t& quantized_samples, quantize_matrix_fn& quantizer)
+{
+    quantized_samples.resize(samples.size());
+
+    #pragma omp parallel for
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        quantizer(samples[i], vocabulary, quantized_samples[i]);
+    }
+}
+
+// The quantizers take a vec_f32_t, so each row of a RaggedMatrix is copied into a
+// buffer that is reused for all samples handled by the same thread
+template <class vocabulary_t, class quantizer_t>
+void quantize_rows_parallel(const RaggedMatrix& samples, const vocabulary_t& vocabulary, vec_vec_f32_t& quantized_samples, quantizer_t& quantizer)
+{
+    quantized_samples.resize(samples.size());
+
+    #pragma omp parallel
+    {
+        vec_f32_t sample;
+
+        #pragma omp for
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            sample.assign(samples[i].begin(), samples[i].end());
+            quantizer(sample, vocabulary, quantized_samples[i]);
+        }
+    }
+}
+
+void quantize_samples_parallel(const RaggedMatrix& samples, const vec_vec_f32_t& vocabulary, vec_vec_f32_t& quantized_samples, quantize_fn& quantizer)
+{
+    quantize_rows_parallel(samples, vocabulary, quantized_samples, quantizer);
+}
+
+void quantize_samples_parallel(const RaggedMatrix& samples, const FeatureMatrix& vocabulary, vec_vec_f32_t& quantized_samples, quantize_matrix_fn& quantizer)
+{
+    quantize_rows_parallel(samples, vocabulary, quantized_samples, quantizer);
+}
+
+// quantized_t and positions_t are either vec_vec_f32_t or RaggedMatrix
+template <class quantized_t, class positions_t>
+void build_histvw_impl(const quantized_t& quantized_features, size_t vocabularySize, vec_f32_t& histvw, bool normalize, const positions_t& positions, int res)
 {
 
     // sanity checking of the input arguments
@@ -97,6 +140,21 @@ void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabularySize
     }
 }
 
+void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabularySize, vec_f32_t& histvw, bool normalize, const vec_vec_f32_t& positions, int res)
+{
+    build_histvw_impl(quantized_features, vocabularySize, histvw, normalize, positions, res);
+}
+
+void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabularySize, vec_f32_t& histvw, bool normalize, const RaggedMatrix& positions, int res)
+{
+    build_histvw_impl(quantized_features, vocabularySize, histvw, normalize, positions, res);
+}
+
+void build_histvw(const RaggedMatrix& quantized_features, size_t vocabularySize, vec_f32_t& histvw, bool normalize, const RaggedMatrix& positions, int res)
+{
+    build_histvw_impl(quantized_features, vocabularySize, histvw, normalize, positions, res);
+}
+
 
 } // end namespace
 
@@ -10,6 +10,8 @@ the terms of the BSD license (see the LICENSE file).
 #define QUANTIZER_HPP
 
 #include "types.hpp"
+#include "feature_matrix.hpp"
+#include "ragged_matrix.hpp"
 
 namespace imdb {
 
@@ -37,10 +39,11 @@ struct quantize_hard {
      * exchanged for each other.
      *
      * @param sample Sample to be quantized
-     * @param vocabulary Vocabulary
+     * @param vocabulary Vocabulary, either a vector<sample_t> or a FeatureMatrix
      * @param quantized_sample
      */
-    void operator()(const sample_t& sample, const vector<sample_t>& vocabulary, vec_f32_t& quantized_sample)
+    template <class vocabulary_t>
+    void operator()(const sample_t& sample, const vocabulary_t& vocabulary, vec_f32_t& quantized_sample)
     {
 
         // this should be very efficient in case the
@@ -84,7 +87,8 @@ struct quantize_fuzzy
         assert(_sigma > 0);
     }
 
-    void operator()(const sample_t& sample, const vector<sample_t>& vocabulary, vec_f32_t& quantized_sample)
+    template <class vocabulary_t>
+    void operator()(const sample_t& sample, const vocabulary_t& vocabulary, vec_f32_t& quantized_sample)
     {
         // this should be very efficient in case the
         // result vector already has the correct size
@@ -127,6 +131,9 @@ struct quantize_fuzzy
  */
 typedef boost::function<void (const vec_f32_t&, const vec_vec_f32_t&, vec_f32_t&)> quantize_fn;
 
+/// Same as quantize_fn but quantizing against a vocabulary stored in a FeatureMatrix
+typedef boost::function<void (const vec_f32_t&, const FeatureMatrix&, vec_f32_t&)> quantize_matrix_fn;
+
 
 
 
@@ -140,6 +147,15 @@ typedef boost::function<void (const vec_f32_t&, const vec_vec_f32_t&, vec_f32_t&
  */
 void quantize_samples_parallel(const vec_vec_f32_t& samples, const vec_vec_f32_t& vocabulary, vec_vec_f32_t& quantized_samples, quantize_fn& quantizer);
 
+/// Overload of quantize_samples_parallel() for a vocabulary stored in a FeatureMatrix
+void quantize_samples_parallel(const vec_vec_f32_t& samples, const FeatureMatrix& vocabulary, vec_vec_f32_t& quantized_samples, quantize_matrix_fn& quantizer);
+
+/// Overload of quantize_samples_parallel() for samples stored in a RaggedMatrix
+void quantize_samples_parallel(const RaggedMatrix& samples, const vec_vec_f32_t& vocabulary, vec_vec_f32_t& quantized_samples, quantize_fn& quantizer);
+
+/// Overload of quantize_samples_parallel() for samples stored in a RaggedMatrix and a vocabulary stored in a FeatureMatrix
+void quantize_samples_parallel(const RaggedMatrix& samples, const FeatureMatrix& vocabulary, vec_vec_f32_t& quantized_samples, quantize_matrix_fn& quantizer);
+
 
 
 // Given a list of quantized samples and corresponding coordinates
@@ -155,6 +171,12 @@ void quantize_samples_parallel(const vec_vec_f32_t& samples, const vec_vec_f32_t
 // we assume that the positions lie in [0,1]x[0,1]
 void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabulary_size, vec_f32_t& histvw, bool normalize, const vec_vec_f32_t& positions = vec_vec_f32_t(), int res = 1);
 
+// Same as above, but with the positions stored in a RaggedMatrix
+void build_histvw(const vec_vec_f32_t& quantized_features, size_t vocabulary_size, vec_f32_t& histvw, bool normalize, const RaggedMatrix& positions, int res = 1);
+
+// Same as above, but with the quantized features stored in a RaggedMatrix
+void build_histvw(const RaggedMatrix& quantized_features, size_t vocabulary_size, vec_f32_t& histvw, bool normalize, const RaggedMatrix& positions = RaggedMatrix(), int res = 1);
+
 
 
 /** @} */
@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef RAGGED_MATRIX_HPP
+#define RAGGED_MATRIX_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/range/iterator_range.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup util
+ * @brief Row-major matrix of float features where each row can have a different length (CSR layout).
+ *
+ * This is the replacement for vec_vec_f32_t when storing the local features of a single image: all
+ * values live in a single contiguous buffer and a second buffer holds the offset of each row, i.e.
+ * row i spans [offsets()[i], offsets()[i+1]). Filling a RaggedMatrix with n rows therefore costs
+ * (amortized) two allocations instead of n+1, and clear() keeps the allocated memory such that a
+ * RaggedMatrix that is reused for the next image does not allocate at all.
+ *
+ * Like FeatureMatrix, RaggedMatrix mimics a vector<vec_f32_t>: size() gives the number of rows and
+ * operator[] returns a lightweight row view. It is serialized exactly like a vec_vec_f32_t (and has
+ * the same type name, see type_names.hpp), so property files can be written from a RaggedMatrix and
+ * read into a vec_vec_f32_t and vice versa.
+ */
+class RaggedMatrix
+{
+    public:
+
+    typedef vec_f32_t                           value_type;
+    typedef boost::iterator_range<const float*> const_row;
+    typedef boost::iterator_range<float*>       row;
+
+    RaggedMatrix() : _offsets(1, 0) {}
+
+    /// Removes all rows, the allocated memory is kept for reuse
+    void clear()
+    {
+        _data.clear();
+        _offsets.resize(1);
+    }
+
+    /// Reserve memory for the given number of rows and the given total number of values
+    void reserve(size_t rows, size_t values)
+    {
+        _offsets.reserve(rows + 1);
+        _data.reserve(values);
+    }
+
+    /// Appends a row, range_t can be any range of values convertible to float, e.g. vec_f32_t or const_row.
+    template <class range_t>
+    void push_back(const range_t& r)
+    {
+        _data.insert(_data.end(), r.begin(), r.end());
+        _offsets.push_back(_data.size());
+    }
+
+    /// Appends a zero-filled row of the given length and returns it such that it can be filled in place.
+    /// Note that the returned view is invalidated by the next append() or push_back().
+    row append(size_t cols)
+    {
+        _data.resize(_data.size() + cols, 0.0f);
+        _offsets.push_back(_data.size());
+        return (*this)[_offsets.size() - 2];
+    }
+
+    const_row operator[] (size_t i) const
+    {
+        const float* p = data();
+        return const_row(p + _offsets[i], p + _offsets[i + 1]);
+    }
+
+    row operator[] (size_t i)
+    {
+        float* p = data();
+        return row(p + _offsets[i], p + _offsets[i + 1]);
+    }
+
+    /// Number of rows, named size() for compatibility with vector<vec_f32_t>
+    size_t size() const { return _offsets.size() - 1; }
+    bool empty() const { return _offsets.size() == 1; }
+
+    size_t rows() const { return _offsets.size() - 1; }
+    size_t row_size(size_t i) const { return _offsets[i + 1] - _offsets[i]; }
+
+    /// Total number of values in all rows
+    size_t num_values() const { return _data.size(); }
+
+    /// Offsets of all rows into data(), contains rows()+1 entries
+    const std::vector<size_t>& offsets() const { return _offsets; }
+
+    const float* data() const { return _data.empty() ? 0 : &_data[0]; }
+    float* data() { return _data.empty() ? 0 : &_data[0]; }
+
+    void swap(RaggedMatrix& other)
+    {
+        _data.swap(other._data);
+        _offsets.swap(other._offsets);
+    }
+
+    bool operator== (const RaggedMatrix& other) const { return _data == other._data && _offsets == other._offsets; }
+
+    private:
+
+    vec_f32_t           _data;
+    std::vector<size_t> _offsets;
+};
+
+inline void swap(RaggedMatrix& a, RaggedMatrix& b)
+{
+    a.swap(b);
+}
+
+} // namespace imdb
+
+#endif // RAGGED_MATRIX_HPP
@@ -0,0 +1,215 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef REDUCED_PRECISION_HPP
+#define REDUCED_PRECISION_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "types.hpp"
+#include "ragged_matrix.hpp"
+
+namespace imdb {
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+
+/**
+ * @brief IEEE 754 half-precision floating point number (storage only).
+ *
+ * float16_t only stores the 16 bits, all arithmetic is done after converting to float, which
+ * happens implicitly. Use it to halve the size of descriptors on disk and in main memory, e.g.
+ * as vec_f16_t instead of vec_f32_t. Conversion from float rounds to the nearest representable value.
+ */
+struct float16_t
+{
+    float16_t() : bits(0) {}
+    float16_t(float f) : bits(from_float(f)) {}
+
+    operator float() const { return to_float(bits); }
+
+    static uint16_t from_float(float f)
+    {
+        uint32_t x;
+        std::memcpy(&x, &f, sizeof(x));
+
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t absx = x & 0x7fffffff;
+
+        // inf and nan
+        if (absx >= 0x7f800000) return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0);
+
+        // too large, becomes inf
+        if (absx >= 0x477ff000) return sign | 0x7c00;
+
+        // subnormal half (or zero)
+        if (absx < 0x38800000)
+        {
+            if (absx < 0x33000000) return sign;
+
+            uint32_t e = absx >> 23;
+            uint32_t m = (absx & 0x7fffff) | 0x800000;
+            uint32_t shift = 126 - e;
+            uint32_t h = m >> shift;
+            uint32_t rem = m & ((1u << shift) - 1);
+            uint32_t half = 1u << (shift - 1);
+            if (rem > half || (rem == half && (h & 1))) h++;
+            return sign | h;
+        }
+
+        // normal half: rebias the exponent and round the mantissa to nearest even
+        uint32_t h = (absx - 0x38000000) >> 13;
+        uint32_t rem = absx & 0x1fff;
+        if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+        return sign | h;
+    }
+
+    static float to_float(uint16_t h)
+    {
+        uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        uint32_t exp  = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+
+        uint32_t x;
+        if (exp == 0)
+        {
+            float f = mant * (1.0f / 16777216.0f);
+            return sign ? -f : f;
+        }
+        else if (exp == 31) x = sign | 0x7f800000 | (mant << 13);
+        else                x = sign | ((exp + 112) << 23) | (mant << 13);
+
+        float f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    uint16_t bits;
+};
+
+typedef std::vector<float16_t> vec_f16_t;
+
+
+/**
+ * @brief Scalar-quantized vector of floats: each value is stored as an int8_t times a per-vector scale.
+ *
+ * Not to be confused with vec_i8_t, which is a plain vector of int8_t.
+ *
+ * Behaves like a read-only vec_f32_t, i.e. size(), operator[] and the iterators yield the dequantized
+ * float values. All distance functions from distance.hpp therefore work directly on vec_q8_t. Create
+ * instances from float data using convert().
+ */
+struct vec_q8_t
+{
+    typedef float value_type;
+
+    class const_iterator : public boost::iterator_facade<const_iterator, float, std::random_access_iterator_tag, float>
+    {
+    public:
+
+        const_iterator() : _p(0), _scale(0) {}
+        const_iterator(const int8_t* p, float scale) : _p(p), _scale(scale) {}
+
+    private:
+
+        friend class boost::iterator_core_access;
+
+        void increment() { ++_p; }
+        void decrement() { --_p; }
+        void advance(std::ptrdiff_t n) { _p += n; }
+        std::ptrdiff_t distance_to(const const_iterator& other) const { return other._p - _p; }
+        bool equal(const const_iterator& other) const { return _p == other._p; }
+        float dereference() const { return *_p * _scale; }
+
+        const int8_t* _p;
+        float         _scale;
+    };
+
+    vec_q8_t() : scale(0) {}
+
+    std::size_t size() const { return data.size(); }
+    bool empty() const { return data.empty(); }
+
+    float operator[] (std::size_t i) const { return data[i] * scale; }
+
+    const_iterator begin() const { return const_iterator(data.empty() ? 0 : &data[0], scale); }
+    const_iterator end() const { return const_iterator(data.empty() ? 0 : &data[0] + data.size(), scale); }
+
+    bool operator== (const vec_q8_t& other) const { return scale == other.scale && data == other.data; }
+
+    float               scale;
+    std::vector<int8_t> data;
+};
+
+
+/// Converts to half precision
+inline void convert(const vec_f32_t& in, vec_f16_t& out)
+{
+    out.assign(in.begin(), in.end());
+}
+
+/// Converts from half precision
+inline void convert(const vec_f16_t& in, vec_f32_t& out)
+{
+    out.assign(in.begin(), in.end());
+}
+
+/// Quantizes to int8, the scale is chosen such that the value with the largest magnitude maps to +/-127
+inline void convert(const vec_f32_t& in, vec_q8_t& out)
+{
+    float maxabs = 0;
+    for (std::size_t i = 0; i < in.size(); i++) maxabs = std::max(maxabs, std::abs(in[i]));
+
+    out.scale = maxabs / 127.0f;
+    out.data.resize(in.size());
+
+    float inv = (maxabs > 0) ? 127.0f / maxabs : 0.0f;
+    for (std::size_t i = 0; i < in.size(); i++) out.data[i] = static_cast<int8_t>(std::floor(in[i] * inv + 0.5f));
+}
+
+/// Dequantizes from int8
+inline void convert(const vec_q8_t& in, vec_f32_t& out)
+{
+    out.assign(in.begin(), in.end());
+}
+
+/// Elementwise conversion of nested vectors, e.g. a vec_vec_f32_t of local features into a std::vector<vec_f16_t>
+template <class A, class B>
+void convert(const std::vector<A>& in, std::vector<B>& out)
+{
+    out.resize(in.size());
+    for (std::size_t i = 0; i < in.size(); i++) convert(in[i], out[i]);
+}
+
+/// Rowwise conversion of a RaggedMatrix of local features, e.g. into a std::vector<vec_f16_t>
+template <class B>
+void convert(const RaggedMatrix& in, std::vector<B>& out)
+{
+    out.resize(in.size());
+    vec_f32_t row;
+    for (std::size_t i = 0; i < in.size(); i++)
+    {
+        row.assign(in[i].begin(), in[i].end());
+        convert(row, out[i]);
+    }
+}
+
+
+/** @} */
+
+} // namespace imdb
+
+#endif // REDUCED_PRECISION_HPP
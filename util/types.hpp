@@ -99,6 +99,19 @@ T get(const anymap_t& map, const std::string& key, const T& defaultvalue = T())
     return (it != map.end()) ? boost::any_cast<T>(it->second) : defaultvalue;
 }
 
+// Stores value under key without copying its content: value is swapped into the
+// map and is left default constructed. Use this to hand over large results such
+// as local features, put(data, "features", features) instead of data["features"] = features.
+template <class T> inline
+void put(anymap_t& map, const std::string& key, T& value)
+{
+    boost::any& a = map[key];
+    a = T();
+
+    using std::swap;
+    swap(boost::any_cast<T&>(a), value);
+}
+
 // Returns the value that is stored in the property_tree under path.
 // If path does not exist, the default value is inserted into the tree
 // and returned.